@@ -0,0 +1,620 @@
+#include <OptionParser.hpp>
+#include <OptionParser_v2.hpp>
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+// Count every heap allocation in the process, reported per iteration as
+// allocs_per_op.
+static std::atomic<std::size_t> g_allocation_count = 0;
+
+void *operator new(std::size_t size) {
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void *ptr = std::malloc(size == 0 ? 1 : size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+void *operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+class AllocationCounter {
+public:
+    explicit AllocationCounter(benchmark::State &state)
+        : m_state(state), m_start(g_allocation_count.load()) {}
+    ~AllocationCounter() {
+        m_state.counters["allocs_per_op"] = benchmark::Counter(
+            static_cast<double>(g_allocation_count.load() - m_start),
+            benchmark::Counter::kAvgIterations);
+    }
+
+private:
+    benchmark::State &m_state;
+    std::size_t m_start;
+};
+
+namespace {
+
+using namespace optionparser_v2;
+
+/// @brief Grammar where every command has fan_out flags, fan_out
+/// subcommands and one parameter, down to depth levels.
+Component makeSyntheticCommand(const std::string &name, int depth,
+                               int fan_out) {
+    std::vector<Component> children;
+    for (int i = 0; i < fan_out; ++i) {
+        children.push_back(makeFlag("--flag" + std::to_string(i),
+                                    "-f" + std::to_string(i), "flag"));
+    }
+    if (depth > 1) {
+        for (int i = 0; i < fan_out; ++i) {
+            children.push_back(makeSyntheticCommand(
+                "cmd" + std::to_string(i), depth - 1, fan_out));
+        }
+    }
+    children.push_back(makeParameter("parameter", "parameter"));
+    return makeCommand(name, "command", std::move(children));
+}
+
+/// @brief Input walking the last command of every level, with a flag on each.
+std::string makeSyntheticInput(int depth, int fan_out) {
+    std::string last = std::to_string(fan_out - 1);
+    std::string input = "root";
+    for (int level = 1; level < depth; ++level) {
+        input += " --flag" + last + " cmd" + last;
+    }
+    input += " --flag" + last + " value";
+    return input;
+}
+
+std::string makeLongInput(std::size_t size) {
+    std::string input = "root";
+    for (int i = 0; input.size() < size; ++i) {
+        input += i % 5 == 0 ? " \"some quoted file name.txt\""
+                            : " path/to/file" + std::to_string(i) + ".cpp";
+    }
+    return input;
+}
+
+void syntheticArgs(benchmark::internal::Benchmark *benchmark) {
+    benchmark->ArgNames({"depth", "fan_out"});
+    benchmark->Args({1, 8})->Args({3, 8})->Args({2, 64})->Args({4, 4});
+}
+
+} // namespace
+
+static void BM_tokenize(benchmark::State &state) {
+    std::string input = makeLongInput(state.range(0));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tokenize(input));
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_tokenize)->Arg(32)->Arg(4 << 10)->Arg(64 << 10);
+
+static void BM_tokenize_scalar(benchmark::State &state) {
+    std::string input = makeLongInput(state.range(0));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(tokenize(input, TokenizerBackend::Scalar));
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_tokenize_scalar)->Arg(32)->Arg(4 << 10)->Arg(64 << 10);
+
+static void BM_ParseContext_parseToken(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    std::string input = makeSyntheticInput(state.range(0), state.range(1));
+    std::vector<std::string_view> tokens = tokenize(input);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        ParseContext context(root);
+        for (auto token : tokens) {
+            benchmark::DoNotOptimize(context.parseToken(token));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+BENCHMARK(BM_ParseContext_parseToken)->Apply(syntheticArgs);
+
+static void BM_CompiledParseContext_parseToken(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    CompiledGrammar grammar(root);
+    std::string input = makeSyntheticInput(state.range(0), state.range(1));
+    std::vector<std::string_view> tokens = tokenize(input);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        CompiledParseContext context(grammar);
+        for (auto token : tokens) {
+            benchmark::DoNotOptimize(context.parseToken(token));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * tokens.size());
+}
+BENCHMARK(BM_CompiledParseContext_parseToken)->Apply(syntheticArgs);
+
+static void BM_parse(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    std::string input = makeSyntheticInput(state.range(0), state.range(1));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parse(root, input));
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_parse)->Apply(syntheticArgs);
+
+static void BM_parseMulti(benchmark::State &state) {
+    std::vector<Component> roots;
+    for (int i = 0; i < 8; ++i) {
+        roots.push_back(makeSyntheticCommand("other" + std::to_string(i),
+                                             state.range(0), state.range(1)));
+    }
+    roots.push_back(
+        makeSyntheticCommand("root", state.range(0), state.range(1)));
+    std::string input = makeSyntheticInput(state.range(0), state.range(1));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parseMulti(roots, input));
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_parseMulti)->Apply(syntheticArgs);
+
+static void BM_parse_CompiledGrammar(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    CompiledGrammar grammar(root);
+    std::string input = makeSyntheticInput(state.range(0), state.range(1));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parse(grammar, input));
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_parse_CompiledGrammar)->Apply(syntheticArgs);
+
+static void BM_parseView(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    CompiledGrammar grammar(root);
+    std::string input = makeSyntheticInput(state.range(0), state.range(1));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parseView(grammar, input));
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_parseView)->Apply(syntheticArgs);
+
+static void BM_parseFlat(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    CompiledGrammar grammar(root);
+    std::string input = makeSyntheticInput(state.range(0), state.range(1));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parseFlat(grammar, input));
+    }
+    state.SetBytesProcessed(state.iterations() * input.size());
+}
+BENCHMARK(BM_parseFlat)->Apply(syntheticArgs);
+
+static void BM_CompiledGrammar_build(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        CompiledGrammar grammar(root);
+        benchmark::DoNotOptimize(grammar);
+    }
+}
+BENCHMARK(BM_CompiledGrammar_build)->Apply(syntheticArgs);
+
+// startup of a short-lived process, building the grammar and parsing one line
+static Component makeGitCommand() {
+    return makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message", {makeParameter("msg", "msg")}),
+         makeFlag("--verbose", "-v", "verbose"),
+         makeCommand("commit", "commit", {makeParameter("path", "path")}),
+         makeCommand("checkout", "checkout", {makeParameter("branch", "branch")}),
+         makeCommand("clone", "clone", {makeParameter("url", "url")})});
+}
+
+constexpr StaticComponent makeStaticGitCommand() {
+    return makeStaticCommand(
+        "git", {makeStaticFlag("--message", "-m", {makeStaticParameter("msg")}),
+                makeStaticFlag("--verbose", "-v"),
+                makeStaticCommand("commit", {makeStaticParameter("path")}),
+                makeStaticCommand("checkout", {makeStaticParameter("branch")}),
+                makeStaticCommand("clone", {makeStaticParameter("url")})});
+}
+
+constexpr auto static_git_grammar = makeStaticGrammar<makeStaticGitCommand>();
+
+static void BM_startup_Component(benchmark::State &state) {
+    std::string_view input = "git -v commit -m hello main.cpp";
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        Component root = makeGitCommand();
+        CompiledGrammar grammar(root);
+        benchmark::DoNotOptimize(parseFlat(grammar, input));
+    }
+}
+BENCHMARK(BM_startup_Component);
+
+static void BM_startup_StaticGrammar(benchmark::State &state) {
+    std::string_view input = "git -v commit -m hello main.cpp";
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        CompiledGrammar grammar(static_git_grammar);
+        benchmark::DoNotOptimize(parseFlat(grammar, input));
+    }
+}
+BENCHMARK(BM_startup_StaticGrammar);
+
+static void BM_loadGrammar(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    std::string data = serializeGrammar(root);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(loadGrammar(data));
+    }
+}
+BENCHMARK(BM_loadGrammar)->Apply(syntheticArgs);
+
+static void BM_nextTokenSuggestions(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    // complete the last level, so the suggestions cover a whole node
+    std::string input = makeSyntheticInput(state.range(0), state.range(1));
+    input.resize(input.rfind(' ') + 1);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(nextTokenSuggestions(root, input));
+    }
+}
+BENCHMARK(BM_nextTokenSuggestions)->Apply(syntheticArgs);
+
+static void BM_nextTokenSuggestions_CompiledGrammar(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    CompiledGrammar grammar(root);
+    std::string input = makeSyntheticInput(state.range(0), state.range(1));
+    input.resize(input.rfind(' ') + 1);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(nextTokenSuggestions(grammar, input));
+    }
+}
+BENCHMARK(BM_nextTokenSuggestions_CompiledGrammar)->Apply(syntheticArgs);
+
+static void BM_nextTokenSuggestions_prefix(benchmark::State &state) {
+    std::vector<Component> children;
+    for (int i = 0; i < state.range(0); ++i) {
+        children.push_back(makeCommand("cmd" + std::to_string(i), "command"));
+    }
+    Component root = makeCommand("root", "command", std::move(children));
+    CompiledGrammar grammar(root);
+    std::string input = "root cmd" + std::to_string(state.range(0) - 1);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        if (state.range(1) != 0) {
+            benchmark::DoNotOptimize(nextTokenSuggestions(grammar, input));
+        } else {
+            benchmark::DoNotOptimize(nextTokenSuggestions(root, input));
+        }
+    }
+}
+BENCHMARK(BM_nextTokenSuggestions_prefix)
+    ->ArgNames({"commands", "compiled"})
+    ->ArgsProduct({{64, 4096}, {0, 1}});
+
+static void BM_nextTokenSuggestions_sink(benchmark::State &state) {
+    std::vector<Component> children;
+    for (int i = 0; i < state.range(0); ++i) {
+        children.push_back(makeCommand("cmd" + std::to_string(i), "command"));
+    }
+    Component root = makeCommand("root", "command", std::move(children));
+    CompiledGrammar grammar(root);
+    std::size_t length = 0;
+    auto sink = [&](std::string_view suggestion) {
+        length += suggestion.size();
+        return true;
+    };
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            nextTokenSuggestions(grammar, "root cmd", sink, 20));
+    }
+    benchmark::DoNotOptimize(length);
+}
+BENCHMARK(BM_nextTokenSuggestions_sink)->ArgName("commands")->Arg(4096);
+
+static void BM_nextTokenSuggestions_vector(benchmark::State &state) {
+    std::vector<Component> children;
+    for (int i = 0; i < state.range(0); ++i) {
+        children.push_back(makeCommand("cmd" + std::to_string(i), "command"));
+    }
+    Component root = makeCommand("root", "command", std::move(children));
+    CompiledGrammar grammar(root);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(nextTokenSuggestions(grammar, "root cmd"));
+    }
+}
+BENCHMARK(BM_nextTokenSuggestions_vector)->ArgName("commands")->Arg(4096);
+
+static void BM_nextTokenCorrections(benchmark::State &state) {
+    std::vector<Component> children;
+    for (int i = 0; i < state.range(0); ++i) {
+        children.push_back(makeCommand("cmd" + std::to_string(i), "command"));
+    }
+    Component root = makeCommand("root", "command", std::move(children));
+    CompiledGrammar grammar(root);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(nextTokenCorrections(grammar, "root cdm12"));
+    }
+}
+BENCHMARK(BM_nextTokenCorrections)->ArgName("commands")->Arg(64)->Arg(4096);
+
+/// @brief Command taking enough path parameters for any makeLongInput line up
+/// to 64 KiB, the same grammar for every line length.
+Component makeLongLineCommand() {
+    std::vector<Component> children;
+    children.push_back(makeFlag("--verbose", "-v", "verbose"));
+    for (std::size_t i = 0; i < tokenize(makeLongInput(64 << 10)).size(); ++i) {
+        children.push_back(makeParameter("path", "path"));
+    }
+    return makeCommand("root", "command", std::move(children));
+}
+
+static void BM_nextTokenSuggestions_keystroke(benchmark::State &state) {
+    std::string input = makeLongInput(state.range(0));
+    Component root = makeLongLineCommand();
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        input.push_back('x');
+        benchmark::DoNotOptimize(nextTokenSuggestions(root, input));
+        input.pop_back();
+    }
+}
+BENCHMARK(BM_nextTokenSuggestions_keystroke)->Arg(64)->Arg(4 << 10);
+
+static void BM_CompletionSession_keystroke(benchmark::State &state) {
+    std::string input = makeLongInput(state.range(0));
+    Component root = makeLongLineCommand();
+    ParseContext context(root);
+    CompletionSession session(context);
+    session.append(input);
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        session.append("x");
+        benchmark::DoNotOptimize(session.getNextSuggestions());
+        session.erase();
+    }
+}
+BENCHMARK(BM_CompletionSession_keystroke)->Arg(64)->Arg(4 << 10);
+
+static void BM_generateHelpString(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(generateHelpString(root));
+    }
+}
+BENCHMARK(BM_generateHelpString)->Apply(syntheticArgs);
+
+static void BM_generateUsageString(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(generateUsageString(root));
+    }
+}
+BENCHMARK(BM_generateUsageString)->Apply(syntheticArgs);
+
+static void BM_HelpRenderer_subcommand(benchmark::State &state) {
+    Component root = makeSyntheticCommand("root", state.range(0),
+                                          state.range(1));
+    // help of the last command one level down
+    const Component *command = &root;
+    for (const Component &child : root.getChildren()) {
+        if (child.isCommand()) {
+            command = &child;
+        }
+    }
+    HelpRenderer renderer(root);
+    AllocationCounter allocations(state);
+    std::size_t size = 0;
+    for (auto _ : state) {
+        renderer.renderHelp(*command,
+                            [&](std::string_view text) { size += text.size(); });
+    }
+    benchmark::DoNotOptimize(size);
+}
+BENCHMARK(BM_HelpRenderer_subcommand)->Apply(syntheticArgs);
+
+static void BM_legacy_Parser_parse(benchmark::State &state) {
+    using namespace OptionParser;
+    // grammar from examples/gcc_command_line_example.cpp
+    Parser parser(
+        Option<WordType>("gcc"), Option<>("-c"), Option<>("-S"), Option<>("-E"),
+        Option<WordType>("-std"), Option<>("-g"), Option<>("-pg"),
+        Option<NumberType<int>>("-O"), Option<ListType>("-W"),
+        Option<WordType>("-W"), Option<>("-pedantic"), Option<ListType>("-I"),
+        Option<WordType>("-I"), Option<ListType>("-L"), Option<WordType>("-L"),
+        Option<ListType>("-D"), Option<WordType>("-D"), Option<WordType>("-U"),
+        Option<ListType>("-f"), Option<WordType>("-f"), Option<ListType>("-m"),
+        Option<WordType>("-m"), Option<WordType>("-o"));
+
+    std::string input_str = "gcc main.cpp -o main -std c++17 -O 3 -D "
+                            "[EXAMPLE_MACRO1=0x1010, EXAMPLE_MACRO2=TEST]";
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parser.parse(input_str));
+    }
+    state.SetBytesProcessed(state.iterations() * input_str.size());
+}
+BENCHMARK(BM_legacy_Parser_parse);
+
+static void BM_legacy_Parser_parse_StaticOption(benchmark::State &state) {
+    using namespace OptionParser;
+    // BM_legacy_Parser_parse grammar with compile time identifiers
+    Parser parser(StaticOption<Identifiers<"gcc">, WordType>{},
+                  StaticOption<Identifiers<"-c">>{},
+                  StaticOption<Identifiers<"-S">>{},
+                  StaticOption<Identifiers<"-E">>{},
+                  StaticOption<Identifiers<"-std">, WordType>{},
+                  StaticOption<Identifiers<"-g">>{},
+                  StaticOption<Identifiers<"-pg">>{},
+                  StaticOption<Identifiers<"-O">, NumberType<int>>{},
+                  StaticOption<Identifiers<"-W">, ListType>{},
+                  StaticOption<Identifiers<"-W">, WordType>{},
+                  StaticOption<Identifiers<"-pedantic">>{},
+                  StaticOption<Identifiers<"-I">, ListType>{},
+                  StaticOption<Identifiers<"-I">, WordType>{},
+                  StaticOption<Identifiers<"-L">, ListType>{},
+                  StaticOption<Identifiers<"-L">, WordType>{},
+                  StaticOption<Identifiers<"-D">, ListType>{},
+                  StaticOption<Identifiers<"-D">, WordType>{},
+                  StaticOption<Identifiers<"-U">, WordType>{},
+                  StaticOption<Identifiers<"-f">, ListType>{},
+                  StaticOption<Identifiers<"-f">, WordType>{},
+                  StaticOption<Identifiers<"-m">, ListType>{},
+                  StaticOption<Identifiers<"-m">, WordType>{},
+                  StaticOption<Identifiers<"-o">, WordType>{});
+
+    std::string input_str = "gcc main.cpp -o main -std c++17 -O 3 -D "
+                            "[EXAMPLE_MACRO1=0x1010, EXAMPLE_MACRO2=TEST]";
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parser.parse(input_str));
+    }
+    state.SetBytesProcessed(state.iterations() * input_str.size());
+}
+BENCHMARK(BM_legacy_Parser_parse_StaticOption);
+
+static void BM_legacy_extractWords(benchmark::State &state) {
+    std::string input_str;
+    for (int i = 0; input_str.size() < static_cast<std::size_t>(state.range(0));
+         ++i) {
+        input_str += i % 4 == 0 ? "some_long_configuration_key,\t"
+                                : "value" + std::to_string(i) + " ";
+    }
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(OptionParser::extractWords(input_str));
+    }
+    state.SetBytesProcessed(state.iterations() * input_str.size());
+}
+BENCHMARK(BM_legacy_extractWords)->Arg(64)->Arg(4 << 10);
+
+/// @brief "-D [MACRO0=0, MACRO1=1, ...]" with count entries.
+std::string makeLegacyListInput(int count) {
+    std::string input_str = "-D [";
+    for (int i = 0; i < count; ++i) {
+        input_str += "MACRO" + std::to_string(i) + "=" + std::to_string(i) +
+                     (i + 1 < count ? ", " : "]");
+    }
+    return input_str;
+}
+
+template <class List>
+static void BM_legacy_Parser_parse_list(benchmark::State &state) {
+    using namespace OptionParser;
+    Parser parser(Option<List>("-D"));
+    std::string input_str = makeLegacyListInput(state.range(0));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parser.parse(input_str));
+    }
+    state.SetBytesProcessed(state.iterations() * input_str.size());
+}
+BENCHMARK(BM_legacy_Parser_parse_list<OptionParser::ListType>)
+    ->Arg(8)
+    ->Arg(4 << 10);
+BENCHMARK(BM_legacy_Parser_parse_list<OptionParser::LazyListType>)
+    ->Arg(8)
+    ->Arg(4 << 10);
+
+/// @brief Parser of count options "-o0", "-o1", ..., alternating words and
+/// lists.
+template <std::size_t... Is>
+auto makeManyOptionsParser(std::index_sequence<Is...>) {
+    using namespace OptionParser;
+    static const std::array<std::string, sizeof...(Is)> names = {
+        ("-o" + std::to_string(Is))...};
+    return Parser(
+        std::conditional_t<Is % 2 == 0, Option<WordType>, Option<ListType>>(
+            names[Is])...);
+}
+
+template <class... Options>
+std::size_t getPairTupleSize(const OptionParser::ResultSet<Options...> &) {
+    // layout of ResultSet before the presence bitmask
+    return sizeof(std::tuple<
+                  std::pair<bool, typename OptionParser::OptionResult<
+                                      Options>::Type>...>);
+}
+
+static void BM_legacy_Parser_parse_many_options(benchmark::State &state) {
+    auto parser = makeManyOptionsParser(std::make_index_sequence<64>{});
+    std::string input_str = "-o2 word -o7 [a, b] -o40 main -o63 [c]";
+    state.counters["result_set_bytes"] = sizeof(parser.parse(""));
+    state.counters["pair_tuple_bytes"] = getPairTupleSize(parser.parse(""));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parser.parse(input_str));
+    }
+    state.SetBytesProcessed(state.iterations() * input_str.size());
+}
+BENCHMARK(BM_legacy_Parser_parse_many_options);
+
+/// @brief Reads a list result through find, copying it.
+static void BM_legacy_ResultSet_find(benchmark::State &state) {
+    using namespace OptionParser;
+    Parser parser(Option<ListType>("-D"));
+    auto set = parser.parse(makeLegacyListInput(64));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        auto result = set.find<0>();
+        benchmark::DoNotOptimize(result->get<0>().size());
+    }
+}
+BENCHMARK(BM_legacy_ResultSet_find);
+
+/// @brief Reads a list result through get, without copying it.
+static void BM_legacy_ResultSet_get(benchmark::State &state) {
+    using namespace OptionParser;
+    Parser parser(Option<ListType>("-D"));
+    auto set = parser.parse(makeLegacyListInput(64));
+    AllocationCounter allocations(state);
+    for (auto _ : state) {
+        auto result = set.get<0>();
+        benchmark::DoNotOptimize(result->get<0>().size());
+    }
+}
+BENCHMARK(BM_legacy_ResultSet_get);
+
+BENCHMARK_MAIN();
@@ -5,7 +5,7 @@
 #include <string>
 
 // Local
-#include "../include/OptionParser.hpp"
+#include "OptionParser.hpp"
 
 #if 1
 
@@ -26,96 +26,96 @@ int main(int argc, char **argv) {
 
     auto set = parser.parse(input_str);
 
-    if (auto gcc_result = set.find<0>()) {
+    if (auto gcc_result = set.get<0>()) {
         std::cout << "gcc argument: " << gcc_result->get<0>() << "\n";
 
-        if (set.find<1>()) {
+        if (set.get<1>()) {
             std::cout << "-c option\n";
-        } else if (set.find<2>()) {
+        } else if (set.get<2>()) {
             std::cout << "-S option\n";
-        } else if (set.find<3>()) {
+        } else if (set.get<3>()) {
             std::cout << "-E option\n";
         }
 
-        if (auto result_std = set.find<4>()) {
+        if (auto result_std = set.get<4>()) {
             std::cout << "-std option: " << result_std->get<0>() << "\n";
         }
 
-        if (set.find<5>()) {
+        if (set.get<5>()) {
             std::cout << "-g option\n";
         }
 
-        if (set.find<6>()) {
+        if (set.get<6>()) {
             std::cout << "-pg option\n";
         }
 
-        if (auto result_O = set.find<7>()) {
+        if (auto result_O = set.get<7>()) {
             std::cout << "-O option: " << result_O->get<0>() << "\n";
         }
 
-        if (auto result_W = set.find<8>()) {
+        if (auto result_W = set.get<8>()) {
             std::cout << "-W option:\n";
             for (auto m : result_W->get<0>()) {
                 std::cout << "\t" << m << "\n";
             }
-        } else if (auto result_W = set.find<9>()) {
+        } else if (auto result_W = set.get<9>()) {
             std::cout << "-W option: " << result_W->get<0>() << "\n";
         }
 
-        if (auto result_pedantic = set.find<10>()) {
+        if (auto result_pedantic = set.get<10>()) {
             std::cout << "-pedantic option\n";
         }
 
-        if (auto result_I = set.find<11>()) {
+        if (auto result_I = set.get<11>()) {
             std::cout << "-I option:\n";
             for (auto m : result_I->get<0>()) {
                 std::cout << "\t" << m << "\n";
             }
-        } else if (auto result_I = set.find<12>()) {
+        } else if (auto result_I = set.get<12>()) {
             std::cout << "-I option: " << result_I->get<0>() << "\n";
         }
 
-        if (auto result_L = set.find<13>()) {
+        if (auto result_L = set.get<13>()) {
             std::cout << "-L option:\n";
             for (auto m : result_L->get<0>()) {
                 std::cout << "\t" << m << "\n";
             }
-        } else if (auto result_L = set.find<14>()) {
+        } else if (auto result_L = set.get<14>()) {
             std::cout << "-L option: " << result_L->get<0>() << "\n";
         }
 
-        if (auto result_D = set.find<15>()) {
+        if (auto result_D = set.get<15>()) {
             std::cout << "-D option:\n";
             for (auto m : result_D->get<0>()) {
                 std::cout << "\t" << m << "\n";
             }
-        } else if (auto result_D = set.find<16>()) {
+        } else if (auto result_D = set.get<16>()) {
             std::cout << "-D option: " << result_D->get<0>() << "\n";
         }
 
-        if (auto result_U = set.find<17>()) {
+        if (auto result_U = set.get<17>()) {
             std::cout << "-U option: " << result_U->get<0>() << "\n";
         }
 
-        if (auto result_f = set.find<18>()) {
+        if (auto result_f = set.get<18>()) {
             std::cout << "-f option:\n";
             for (auto m : result_f->get<0>()) {
                 std::cout << "\t" << m << "\n";
             }
-        } else if (auto result_f = set.find<19>()) {
+        } else if (auto result_f = set.get<19>()) {
             std::cout << "-f option: " << result_f->get<0>() << "\n";
         }
 
-        if (auto result_m = set.find<20>()) {
+        if (auto result_m = set.get<20>()) {
             std::cout << "-m option:\n";
             for (auto m : result_m->get<0>()) {
                 std::cout << "\t" << m << "\n";
             }
-        } else if (auto result_m = set.find<21>()) {
+        } else if (auto result_m = set.get<21>()) {
             std::cout << "-m option: " << result_m->get<0>() << "\n";
         }
 
-        if (auto result_o = set.find<22>()) {
+        if (auto result_o = set.get<22>()) {
             std::cout << "-o option: " << result_o->get<0>() << "\n";
         }
     }
@@ -1,140 +1,302 @@
 
 #include "OptionParser.hpp"
 
+#include <bit>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OptionParser_X86_SIMD
+#include <immintrin.h>
+#endif
+
 namespace OptionParser {
 
+std::size_t findScalar(std::string_view str_view, const DelimSet &delim_set,
+                       std::size_t pos, bool in_set) {
+    for (; pos < str_view.size(); ++pos) {
+        if (delim_set.contains(str_view[pos]) == in_set)
+            return pos;
+    }
+    return str_view.npos;
+}
+
+#ifdef OptionParser_X86_SIMD
+__attribute__((target("sse4.2"))) std::size_t
+findSse42(std::string_view str_view, const DelimSet &delim_set,
+          std::size_t pos, bool in_set) {
+    __m128i chars[8];
+    for (std::size_t i = 0; i < delim_set.char_count; ++i) {
+        chars[i] = _mm_set1_epi8(delim_set.chars[i]);
+    }
+    const unsigned flip = in_set ? 0 : 0xffff;
+    for (; pos + 16 <= str_view.size(); pos += 16) {
+        __m128i chunk = _mm_loadu_si128(
+            reinterpret_cast<const __m128i *>(str_view.data() + pos));
+        __m128i match = _mm_setzero_si128();
+        for (std::size_t i = 0; i < delim_set.char_count; ++i) {
+            match = _mm_or_si128(match, _mm_cmpeq_epi8(chunk, chars[i]));
+        }
+        unsigned mask =
+            static_cast<unsigned>(_mm_movemask_epi8(match)) ^ flip;
+        if (mask != 0)
+            return pos + std::countr_zero(mask);
+    }
+    return findScalar(str_view, delim_set, pos, in_set);
+}
+
+__attribute__((target("avx2"))) std::size_t
+findAvx2(std::string_view str_view, const DelimSet &delim_set, std::size_t pos,
+         bool in_set) {
+    __m256i chars[8];
+    for (std::size_t i = 0; i < delim_set.char_count; ++i) {
+        chars[i] = _mm256_set1_epi8(delim_set.chars[i]);
+    }
+    const std::uint32_t flip = in_set ? 0 : 0xffffffff;
+    for (; pos + 32 <= str_view.size(); pos += 32) {
+        __m256i chunk = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(str_view.data() + pos));
+        __m256i match = _mm256_setzero_si256();
+        for (std::size_t i = 0; i < delim_set.char_count; ++i) {
+            match = _mm256_or_si256(match, _mm256_cmpeq_epi8(chunk, chars[i]));
+        }
+        std::uint32_t mask =
+            static_cast<std::uint32_t>(_mm256_movemask_epi8(match)) ^ flip;
+        if (mask != 0)
+            return pos + std::countr_zero(mask);
+    }
+    // the rest is shorter than a 32 byte block
+    return findSse42(str_view, delim_set, pos, in_set);
+}
+#endif
+
+using FindFunc = std::size_t (*)(std::string_view, const DelimSet &,
+                                 std::size_t, bool);
+
+bool isFindBackendSupported(FindBackend backend) {
+    switch (backend) {
+    case FindBackend::Scalar:
+        return true;
+#ifdef OptionParser_X86_SIMD
+    case FindBackend::Sse42:
+        return __builtin_cpu_supports("sse4.2");
+    case FindBackend::Avx2:
+        return __builtin_cpu_supports("avx2");
+#else
+    case FindBackend::Sse42:
+    case FindBackend::Avx2:
+        return false;
+#endif
+    }
+    return false;
+}
+
+FindBackend getFindBackend() {
+    static const FindBackend backend = [] {
+        for (auto backend : {FindBackend::Avx2, FindBackend::Sse42}) {
+            if (isFindBackendSupported(backend))
+                return backend;
+        }
+        return FindBackend::Scalar;
+    }();
+    return backend;
+}
+
+FindFunc getFindFunc(FindBackend backend) {
+    assert(isFindBackendSupported(backend));
+    switch (backend) {
+    case FindBackend::Scalar:
+        break;
+#ifdef OptionParser_X86_SIMD
+    case FindBackend::Sse42:
+        return findSse42;
+    case FindBackend::Avx2:
+        return findAvx2;
+#else
+    case FindBackend::Sse42:
+    case FindBackend::Avx2:
+        break;
+#endif
+    }
+    return findScalar;
+}
+
+std::size_t findDelim(std::string_view str_view, const DelimSet &delim_set,
+                      std::size_t pos, bool in_set, FindBackend backend) {
+    // the kernels only compare against the first characters of the set
+    if (delim_set.char_count > delim_set.chars.size())
+        return findScalar(str_view, delim_set, pos, in_set);
+    return getFindFunc(backend)(str_view, delim_set, pos, in_set);
+}
+
+std::size_t findDelim(std::string_view str_view, const DelimSet &delim_set,
+                      std::size_t pos, bool in_set) {
+    static const FindFunc find_func = getFindFunc(getFindBackend());
+    // words are mostly short, so the first bytes are not worth the kernel
+    // setup
+    std::size_t scalar_end = std::min(str_view.size(), pos + 16);
+    for (; pos < scalar_end; ++pos) {
+        if (delim_set.contains(str_view[pos]) == in_set)
+            return pos;
+    }
+    if (pos == str_view.size())
+        return str_view.npos;
+    if (delim_set.char_count > delim_set.chars.size())
+        return findScalar(str_view, delim_set, pos, in_set);
+    return find_func(str_view, delim_set, pos, in_set);
+}
+
+std::size_t findFirstOf(std::string_view str_view, const DelimSet &delim_set,
+                        std::size_t pos) {
+    return findDelim(str_view, delim_set, pos, true);
+}
+
+std::size_t findFirstNotOf(std::string_view str_view,
+                           const DelimSet &delim_set, std::size_t pos) {
+    return findDelim(str_view, delim_set, pos, false);
+}
+
+std::size_t findFirstOf(std::string_view str_view, const DelimSet &delim_set,
+                        std::size_t pos, FindBackend backend) {
+    return findDelim(str_view, delim_set, pos, true, backend);
+}
+
+std::size_t findFirstNotOf(std::string_view str_view,
+                           const DelimSet &delim_set, std::size_t pos,
+                           FindBackend backend) {
+    return findDelim(str_view, delim_set, pos, false, backend);
+}
+
+// most calls use the default delims, which are already a set
+DelimSet toDelimSet(std::string_view delim) {
+    if (delim == OptionParser_DEFAULT_DELIM)
+        return default_delim_set;
+    return DelimSet(delim);
+}
+
 std::vector<std::string_view> extractWords(std::string_view str_view,
-                                           const std::string_view &delim) {
+                                           const DelimSet &delim_set) {
     std::vector<std::string_view> word_vec;
-    while (!str_view.empty()) {
-        std::size_t delim_pos = str_view.find_first_of(delim);
-        std::size_t word_pos = str_view.find_first_not_of(delim);
-        if (delim_pos == str_view.npos) {
-            word_vec.push_back(str_view);
+    std::size_t pos = 0;
+    while (true) {
+        std::size_t word_pos = findFirstNotOf(str_view, delim_set, pos);
+        if (word_pos == str_view.npos)
             break;
-        } else if (word_pos == str_view.npos) {
+        pos = findFirstOf(str_view, delim_set, word_pos);
+        word_vec.push_back(str_view.substr(word_pos, pos - word_pos));
+        if (pos == str_view.npos)
             break;
-        } else if (delim_pos > word_pos) {
-            word_vec.push_back(str_view.substr(0, delim_pos));
-            str_view.remove_prefix(delim_pos);
-        } else {
-            str_view.remove_prefix(word_pos);
-        }
     }
     return word_vec;
 }
 
+std::vector<std::string_view> extractWords(std::string_view str_view,
+                                           const std::string_view &delim) {
+    return extractWords(str_view, toDelimSet(delim));
+}
+
+std::pair<std::string_view, std::size_t>
+removePrefixDelim(std::string_view str_view, const DelimSet &delim_set) {
+    auto word_pos = findFirstNotOf(str_view, delim_set);
+    if (word_pos == str_view.npos)
+        word_pos = str_view.size();
+    return std::make_pair(str_view.substr(word_pos), word_pos);
+}
+
 std::pair<std::string_view, std::size_t>
 removePrefixDelim(std::string_view str_view, const std::string_view &delim) {
-    auto delim_pos = str_view.find_first_of(delim);
-    if (delim_pos == str_view.npos)
-        return std::make_pair(str_view, 0);
-    auto word_pos = str_view.find_first_not_of(delim);
-    if (word_pos == str_view.npos) {
-        std::size_t s = str_view.size();
-        str_view.remove_prefix(str_view.size());
-        return std::make_pair(str_view, s);
-    }
-    if (word_pos < delim_pos) {
-        return std::make_pair(str_view, 0);
-    } else {
-        str_view.remove_prefix(word_pos);
-        return std::make_pair(str_view, word_pos);
-    }
+    return removePrefixDelim(str_view, toDelimSet(delim));
 }
 
 std::pair<std::string_view, std::size_t>
-extractFirstWord(std::string_view str_view, const std::string_view &delim) {
-    auto pair = removePrefixDelim(str_view, delim);
-    auto delim_pos = pair.first.find_first_of(delim);
+extractFirstWord(std::string_view str_view, const DelimSet &delim_set) {
+    auto pair = removePrefixDelim(str_view, delim_set);
+    auto delim_pos = findFirstOf(pair.first, delim_set);
     if (delim_pos == pair.first.npos)
         return std::make_pair(pair.first, pair.second + pair.first.size());
-    auto word_pos = pair.first.find_first_not_of(delim);
-    if (word_pos == pair.first.npos) {
-        str_view.remove_prefix(pair.first.size());
-        return std::make_pair(pair.first, pair.second);
-    }
     return std::make_pair(pair.first.substr(0, delim_pos),
                           pair.second + delim_pos);
 }
 
+std::pair<std::string_view, std::size_t>
+extractFirstWord(std::string_view str_view, const std::string_view &delim) {
+    return extractFirstWord(str_view, toDelimSet(delim));
+}
+
+bool hasPrefixDelim(std::string_view str_view, const DelimSet &delim_set) {
+    return !str_view.empty() && delim_set.contains(str_view.front());
+}
+
 bool hasPrefixDelim(std::string_view str_view, const std::string_view &delim) {
-    auto delim_pos = str_view.find_first_of(delim);
-    auto word_pos = str_view.find_first_not_of(delim);
-    if (delim_pos == str_view.npos && word_pos == str_view.npos) {
-        return false;
-    } else if (delim_pos == str_view.npos) {
-        return false;
-    } else if (word_pos == str_view.npos) {
-        return true;
-    } else if (delim_pos > word_pos) {
-        return false;
-    } else /* if (delim_pos < word_pos) */ {
-        return true;
-    }
+    return hasPrefixDelim(str_view, toDelimSet(delim));
+}
+
+std::pair<std::string_view, std::size_t>
+removeFirstWord(std::string_view str_view, const DelimSet &delim_set) {
+    // delims, word and delims, each scanned once
+    std::size_t pos = findFirstNotOf(str_view, delim_set);
+    if (pos != str_view.npos)
+        pos = findFirstOf(str_view, delim_set, pos);
+    if (pos != str_view.npos)
+        pos = findFirstNotOf(str_view, delim_set, pos);
+    if (pos == str_view.npos)
+        pos = str_view.size();
+    return std::make_pair(str_view.substr(pos), pos);
 }
 
 std::pair<std::string_view, std::size_t>
 removeFirstWord(std::string_view str_view, const std::string_view &delim) {
-    std::size_t s = 0;
-    auto pair = removePrefixDelim(str_view, delim);
-    s += pair.second;
-    auto first_word = extractFirstWord(pair.first, delim);
-    pair.first.remove_prefix(first_word.first.size());
-    s += first_word.first.size();
-    pair = removePrefixDelim(pair.first, delim);
-    s += pair.second;
-    return std::make_pair(pair.first, s);
+    return removeFirstWord(str_view, toDelimSet(delim));
 }
 
 std::optional<std::string_view>
 extractFirstWordDestructive(std::string_view &str_view,
-                            const std::string_view &delim) {
-    auto pair1 = extractFirstWord(str_view, delim);
+                            const DelimSet &delim_set) {
+    auto pair1 = extractFirstWord(str_view, delim_set);
     if (pair1.first.empty()) {
         return std::nullopt;
     } else {
-        auto pair2 = removeFirstWord(str_view, delim);
+        auto pair2 = removeFirstWord(str_view, delim_set);
         str_view = pair2.first;
         return pair1.first;
     }
 }
 
-std::size_t searchEndOfList(std::string_view str_view, char begin, char end) {
+std::optional<std::string_view>
+extractFirstWordDestructive(std::string_view &str_view,
+                            const std::string_view &delim) {
+    return extractFirstWordDestructive(str_view, toDelimSet(delim));
+}
+
+std::size_t searchEndOfList(std::string_view str_view, char begin, char end,
+                            std::size_t max_depth) {
     assert(begin != end);
 
-    if (str_view.empty())
+    if (str_view.empty() || max_depth == 0)
         return str_view.npos;
 
-    str_view.remove_prefix(1); // remove first begin
+    // jump from bracket to bracket, skipping everything else
+    const char brackets[] = {begin, end};
+    const DelimSet bracket_set(std::string_view(brackets, 2));
     std::size_t count = 1;
-
-    std::size_t total_pos = 0;
-
-    while (count > 0) {
-        auto end_pos = str_view.find(end);
-        if (end_pos == str_view.npos)
+    std::size_t pos = 0;
+    while (true) {
+        pos = findFirstOf(str_view, bracket_set, pos + 1);
+        if (pos == str_view.npos)
             return str_view.npos;
-        auto begin_pos = str_view.find(begin);
-        if (begin_pos < end_pos) {
-            str_view.remove_prefix(begin_pos + 1);
-            total_pos += begin_pos + 1;
-            ++count;
-        } else {
-            str_view.remove_prefix(end_pos + 1);
-            total_pos += end_pos + 1;
-            --count;
+        if (str_view[pos] == begin) {
+            if (++count > max_depth)
+                return str_view.npos;
+        } else if (--count == 0) {
+            return pos;
         }
     }
-    return total_pos;
 }
 
 std::pair<std::string_view, std::size_t>
 extractFirstList(std::string_view str_view, char begin, char end,
-                 const std::string_view &delim) {
+                 const std::string_view &delim, std::size_t max_depth) {
     assert(begin != end);
     auto pair = removePrefixDelim(str_view, delim);
-    auto end_pos = searchEndOfList(pair.first, begin, end);
+    auto end_pos = searchEndOfList(pair.first, begin, end, max_depth);
     if (end_pos == pair.first.npos) {
         return std::make_pair(pair.first.substr(0, 0), pair.second);
     } else {
@@ -143,6 +305,25 @@ extractFirstList(std::string_view str_view, char begin, char end,
     }
 }
 
+std::pair<std::string_view, std::size_t>
+extractListElement(std::string_view list, std::size_t pos,
+                   const DelimSet &delim_set) {
+    pos = findFirstNotOf(list, delim_set, pos);
+    if (pos == list.npos)
+        return std::make_pair(list.substr(list.size()), list.size());
+    if (list[pos] == '[') {
+        // a nested list is one element
+        auto end_pos = searchEndOfList(list.substr(pos));
+        if (end_pos != list.npos)
+            return std::make_pair(list.substr(pos, end_pos + 1),
+                                  pos + end_pos + 1);
+    }
+    auto end_pos = findFirstOf(list, delim_set, pos);
+    if (end_pos == list.npos)
+        end_pos = list.size();
+    return std::make_pair(list.substr(pos, end_pos - pos), end_pos);
+}
+
 std::pair<std::string_view, std::size_t>
 extractFirstString(std::string_view str_view, const std::string_view &delim) {
     auto pair = removePrefixDelim(str_view, delim);
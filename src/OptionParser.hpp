@@ -8,6 +8,8 @@
 // C++
 #include <algorithm>
 #include <array>
+#include <bit>
+#include <bitset>
 #include <cassert>
 #include <charconv>
 #include <cstdint>
@@ -15,6 +17,7 @@
 #include <iostream>
 #include <istream>
 #include <iterator>
+#include <memory>
 #include <optional>
 #include <sstream>
 #include <string>
@@ -27,12 +30,86 @@
 namespace OptionParser {
 #define OptionParser_DEFAULT_DELIM " \t,"
 
+/*
+Set of delimiter characters as a 256 bit bitmap.
+Built at compile time from a string, and usable as a template parameter.
+*/
+struct DelimSet {
+    constexpr DelimSet(std::string_view delim) {
+        for (char c : delim) {
+            if (contains(c))
+                continue;
+            auto uc = static_cast<unsigned char>(c);
+            bits[uc / 64] |= std::uint64_t(1) << (uc % 64);
+            if (char_count < chars.size())
+                chars[char_count] = c;
+            ++char_count;
+        }
+    }
+
+    constexpr bool contains(char c) const {
+        auto uc = static_cast<unsigned char>(c);
+        return (bits[uc / 64] >> (uc % 64)) & 1;
+    }
+
+    std::array<std::uint64_t, 4> bits = {};
+    // the first characters of the set, for the SIMD kernels
+    std::array<char, 8> chars = {};
+    std::size_t char_count = 0;
+};
+
+inline constexpr DelimSet default_delim_set(OptionParser_DEFAULT_DELIM);
+
+/*
+Find first character in delim_set, starting at pos.
+Scans 16 or 32 bytes at a time with SSE4.2 or AVX2 if the CPU supports it and
+the set has at most 8 characters.
+*/
+std::size_t findFirstOf(std::string_view str_view, const DelimSet &delim_set,
+                        std::size_t pos = 0);
+
+/*
+Find first character not in delim_set, starting at pos.
+*/
+std::size_t findFirstNotOf(std::string_view str_view,
+                           const DelimSet &delim_set, std::size_t pos = 0);
+
+/*
+Implementations of findFirstOf and findFirstNotOf. The SIMD backends compare
+16 or 32 bytes at a time against each character of the set, sets of more than
+8 characters are always scanned with the scalar bitmap loop.
+*/
+enum class FindBackend { Scalar, Sse42, Avx2 };
+
+/*
+Check if the backend is compiled in and supported by the CPU.
+*/
+bool isFindBackendSupported(FindBackend backend);
+
+/*
+Get the backend findFirstOf and findFirstNotOf use, the best one supported by
+the CPU.
+*/
+FindBackend getFindBackend();
+
+/*
+findFirstOf and findFirstNotOf with a specific backend, the backend must be
+supported.
+*/
+std::size_t findFirstOf(std::string_view str_view, const DelimSet &delim_set,
+                        std::size_t pos, FindBackend backend);
+std::size_t findFirstNotOf(std::string_view str_view,
+                           const DelimSet &delim_set, std::size_t pos,
+                           FindBackend backend);
+
 /*
 Split string by spaces.
 */
 std::vector<std::string_view>
 extractWords(std::string_view str_view,
              const std::string_view &delim = OptionParser_DEFAULT_DELIM);
+std::vector<std::string_view> extractWords(std::string_view str_view,
+                                           const DelimSet &delim_set);
 
 /*
 Remove prefix delim.
@@ -40,6 +117,8 @@ Remove prefix delim.
 std::pair<std::string_view, std::size_t>
 removePrefixDelim(std::string_view str_view,
                   const std::string_view &delim = OptionParser_DEFAULT_DELIM);
+std::pair<std::string_view, std::size_t>
+removePrefixDelim(std::string_view str_view, const DelimSet &delim_set);
 
 /*
 Get first word.
@@ -47,12 +126,15 @@ Get first word.
 std::pair<std::string_view, std::size_t>
 extractFirstWord(std::string_view str_view,
                  const std::string_view &delim = OptionParser_DEFAULT_DELIM);
+std::pair<std::string_view, std::size_t>
+extractFirstWord(std::string_view str_view, const DelimSet &delim_set);
 
 /*
 Check if string has delim before first not delim.
 */
 bool hasPrefixDelim(std::string_view str_view,
                     const std::string_view &delim = " \t");
+bool hasPrefixDelim(std::string_view str_view, const DelimSet &delim_set);
 
 /*
 Remove first word (and delims).
@@ -60,6 +142,8 @@ Remove first word (and delims).
 std::pair<std::string_view, std::size_t>
 removeFirstWord(std::string_view str_view,
                 const std::string_view &delim = OptionParser_DEFAULT_DELIM);
+std::pair<std::string_view, std::size_t>
+removeFirstWord(std::string_view str_view, const DelimSet &delim_set);
 
 /*
 Try to extract first word.
@@ -68,20 +152,36 @@ If succesful then remove word from str_view.
 std::optional<std::string_view> extractFirstWordDestructive(
     std::string_view &str_view,
     const std::string_view &delim = OptionParser_DEFAULT_DELIM);
+std::optional<std::string_view>
+extractFirstWordDestructive(std::string_view &str_view,
+                            const DelimSet &delim_set);
 
 /*
 Search for end of list.
 (first char must be start of list).
+Brackets are found in one pass over the input, npos if the list is not closed
+or nests deeper than max_depth. The depth is not limited by default.
 */
 std::size_t searchEndOfList(std::string_view str_view, char begin = '[',
-                            char end = ']');
+                            char end = ']',
+                            std::size_t max_depth = std::string_view::npos);
 
 /*
 Extract list from string.
 */
 std::pair<std::string_view, std::size_t>
 extractFirstList(std::string_view str_view, char begin = '[', char end = ']',
-                 const std::string_view &delim = OptionParser_DEFAULT_DELIM);
+                 const std::string_view &delim = OptionParser_DEFAULT_DELIM,
+                 std::size_t max_depth = std::string_view::npos);
+
+/*
+Get the first element of a list at or after pos, a word or a nested list.
+Returns the element and the position after it, the element is empty if there
+are no more elements.
+*/
+std::pair<std::string_view, std::size_t>
+extractListElement(std::string_view list, std::size_t pos,
+                   const DelimSet &delim_set = default_delim_set);
 
 /*
 Parse extracted list.
@@ -94,6 +194,77 @@ parseList(std::string_view str_view,
     return extractWords(str_view, delim);
 }
 
+/*
+Extracted list, split into elements while iterating instead of into a vector.
+Unlike parseList, a nested list is one element.
+*/
+class ListView {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::string_view;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = std::string_view;
+
+        Iterator() = default;
+        Iterator(const ListView *list_view, std::size_t pos)
+            : m_list_view(list_view) {
+            advance(pos);
+        }
+
+        std::string_view operator*() const { return m_element; }
+        Iterator &operator++() {
+            advance(m_next);
+            return *this;
+        }
+        Iterator operator++(int) {
+            Iterator it = *this;
+            ++*this;
+            return it;
+        }
+        bool operator==(const Iterator &other) const {
+            return m_element.empty() ? other.m_element.empty()
+                                     : m_element.data() ==
+                                           other.m_element.data();
+        }
+
+    private:
+        void advance(std::size_t pos) {
+            auto pair = extractListElement(m_list_view->m_elements, pos,
+                                           m_list_view->m_delim_set);
+            m_element = pair.first;
+            m_next = pair.second;
+        }
+
+        const ListView *m_list_view = nullptr;
+        std::string_view m_element;
+        std::size_t m_next = 0;
+    };
+
+    ListView() = default;
+
+    /*
+    View the list extracted by extractFirstList, brackets included.
+    */
+    ListView(std::string_view list,
+             const DelimSet &delim_set = default_delim_set)
+        : m_delim_set(delim_set) {
+        if (list.size() >= 2)
+            m_elements = list.substr(1, list.size() - 2);
+    }
+
+    Iterator begin() const { return Iterator(this, 0); }
+    Iterator end() const { return Iterator(); }
+    bool empty() const { return begin() == end(); }
+    std::size_t size() const { return std::distance(begin(), end()); }
+
+private:
+    std::string_view m_elements;
+    DelimSet m_delim_set = default_delim_set;
+};
+
 /*
 Extract string.
 */
@@ -138,6 +309,23 @@ struct ListType {
     }
     std::vector<std::string_view> type;
 };
+/*
+ListType splitting the list on demand, parsing does not allocate.
+Unlike ListType, a nested list is one element.
+*/
+struct LazyListType {
+    bool parseType(std::string_view &str_view, const std::string_view &delim) {
+        auto pair = extractFirstList(str_view, '[', ']', delim);
+        if (!pair.first.empty()) {
+            type = ListView(pair.first, DelimSet(delim));
+            str_view.remove_prefix(pair.second);
+            return true;
+        } else {
+            return false;
+        }
+    }
+    ListView type;
+};
 struct StringType {
     bool parseType(std::string_view &str_view, const std::string_view &delim) {
         auto pair = extractFirstString(str_view, delim);
@@ -231,7 +419,7 @@ public:
 
         // check and parse params
         ResultType result;
-        if (parseParams(result, temp_view, delim)) {
+        if (parseParameters(result, temp_view, delim)) {
             input_view = temp_view;
             return result;
         } else {
@@ -239,15 +427,30 @@ public:
         }
     }
 
+    /*
+    Parse the params following an identifier that was already matched.
+    str_view is only advanced past the params if all of them parsed.
+    */
+    static bool parseParameters(ResultType &result, std::string_view &str_view,
+                                const std::string_view &delim) {
+        std::string_view temp_view = str_view;
+        if (!traverseParams(result, temp_view, delim,
+                            std::make_index_sequence<sizeof...(Params)>{})) {
+            return false;
+        }
+        str_view = temp_view;
+        return true;
+    }
+
     constexpr std::size_t getSize() const { return sizeof...(Params); }
 
     constexpr auto &getIdentifiers() const { return m_identifiers; }
 
 private:
     template <std::size_t... Is>
-    bool traverseParams(ResultType &result, std::string_view &str_view,
-                        const std::string_view &delim,
-                        std::index_sequence<Is...>) const {
+    static bool traverseParams(ResultType &result, std::string_view &str_view,
+                               const std::string_view &delim,
+                               std::index_sequence<Is...>) {
         bool failed = false;
         (
             [&](auto &type) {
@@ -259,13 +462,154 @@ private:
         return !failed;
     }
 
-    bool parseParams(ResultType &result, std::string_view &str_view,
-                     const std::string_view &delim) const {
-        return traverseParams(result, str_view, delim,
-                              std::make_index_sequence<sizeof...(Params)>{});
+    std::vector<std::string_view> m_identifiers;
+};
+
+/*
+String usable as a template parameter, for identifiers known at compile time.
+*/
+template <std::size_t N> struct FixedString {
+    constexpr FixedString(const char (&str)[N]) {
+        std::copy_n(str, N, value);
     }
 
-    std::vector<std::string_view> m_identifiers;
+    constexpr std::string_view view() const {
+        return std::string_view(value, N - 1);
+    }
+
+    char value[N];
+};
+
+/*
+Identifiers of a StaticOption.
+*/
+template <FixedString... Ids> struct Identifiers {
+    static constexpr std::array<std::string_view, sizeof...(Ids)> values = {
+        Ids.view()...};
+};
+
+/*
+Option with identifiers fixed at compile time.
+A Parser where every option is a StaticOption looks up the options for each
+word in a dispatch table built at compile time, instead of trying every option.
+Example: StaticOption<Identifiers<"-a", "--alpha">, NumberType<int>>{}
+*/
+template <class Ids, class... Params> class StaticOption {
+public:
+    using ResultType = Result<Params...>;
+
+    static constexpr auto identifiers = Ids::values;
+
+    static constexpr bool checkIdentifier(const std::string_view &str) {
+        return std::find(identifiers.begin(), identifiers.end(), str) !=
+               identifiers.end();
+    }
+
+    std::optional<ResultType>
+    parse(std::string_view &input_view,
+          const std::string_view &delim = OptionParser_DEFAULT_DELIM) const {
+        if (input_view.empty())
+            return std::nullopt;
+        std::string_view temp_view = input_view;
+        auto pair = extractFirstWord(temp_view, delim);
+        if (!checkIdentifier(pair.first))
+            return std::nullopt;
+        temp_view.remove_prefix(pair.second);
+
+        ResultType result;
+        if (!parseParameters(result, temp_view, delim))
+            return std::nullopt;
+        input_view = temp_view;
+        return result;
+    }
+
+    static bool parseParameters(ResultType &result, std::string_view &str_view,
+                                const std::string_view &delim) {
+        return Option<Params...>::parseParameters(result, str_view, delim);
+    }
+
+    constexpr std::size_t getSize() const { return sizeof...(Params); }
+
+    constexpr auto &getIdentifiers() const { return identifiers; }
+};
+
+template <class T> struct IsStaticOption : std::false_type {};
+
+template <class Ids, class... Params>
+struct IsStaticOption<StaticOption<Ids, Params...>> : std::true_type {};
+
+/*
+Table from the identifiers of StaticOptions to the options, in option order.
+Identifiers are hashed on length, first and last character into buckets, the
+entries of a bucket are contiguous.
+*/
+template <class... Options> struct DispatchTable {
+    struct Entry {
+        std::string_view identifier;
+        std::size_t option;
+    };
+
+    static constexpr std::size_t entry_count =
+        (Options::identifiers.size() + ... + 0);
+    static constexpr std::size_t bucket_count =
+        std::bit_ceil(std::max<std::size_t>(entry_count * 2, 1));
+
+    static constexpr std::size_t bucket(std::string_view word) {
+        return (word.size() * 131 +
+                static_cast<unsigned char>(word.front()) * 31 +
+                static_cast<unsigned char>(word.back())) &
+               (bucket_count - 1);
+    }
+
+    constexpr DispatchTable() {
+        std::array<Entry, entry_count> all = {};
+        std::size_t n = 0;
+        std::size_t option = 0;
+        (
+            [&]() {
+                for (std::string_view identifier : Options::identifiers) {
+                    all[n++] = Entry{identifier, option};
+                }
+                ++option;
+            }(),
+            ...);
+        // counting sort into buckets, keeping option order within a bucket
+        for (std::size_t i = 0; i < entry_count; ++i) {
+            if (!all[i].identifier.empty()) {
+                ++bucket_begin[bucket(all[i].identifier) + 1];
+            }
+        }
+        for (std::size_t b = 0; b < bucket_count; ++b) {
+            bucket_begin[b + 1] += bucket_begin[b];
+        }
+        std::array<std::size_t, bucket_count> fill = {};
+        for (std::size_t i = 0; i < entry_count; ++i) {
+            if (!all[i].identifier.empty()) {
+                std::size_t b = bucket(all[i].identifier);
+                entries[bucket_begin[b] + fill[b]++] = all[i];
+            }
+        }
+    }
+
+    /*
+    Call f with the option index of every entry matching word, in option
+    order, until f returns true.
+    */
+    template <class Func>
+    constexpr bool find(std::string_view word, Func &&f) const {
+        if (word.empty())
+            return false;
+        std::size_t b = bucket(word);
+        for (std::size_t i = bucket_begin[b]; i < bucket_begin[b + 1]; ++i) {
+            if (entries[i].identifier == word && f(entries[i].option)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::array<std::size_t, bucket_count + 1> bucket_begin = {};
+    std::array<Entry, entry_count> entries = {};
 };
 
 template <typename T1 = void, typename T2 = void, typename... Ts>
@@ -285,31 +629,181 @@ template <class... Params> struct OptionResult<Option<Params...>> {
     using Type = Result<Params...>;
 };
 
+template <class Ids, class... Params>
+struct OptionResult<StaticOption<Ids, Params...>> {
+    using Type = Result<Params...>;
+};
+
 template <class... Options> class Parser;
 
+/*
+Results of a parse, one per option of the Parser.
+Which options were found is kept in one bitmask, a result is only constructed
+in its storage when its option is found.
+find<i>() returns a copy of the result of option i. get<i>() returns a pointer
+to it, or nullptr if the option was not found, and is used by structured
+bindings: const auto &[a, b] = result_set; gives one pointer per option.
+*/
 template <class... Options> class ResultSet {
 public:
-    using ResultTuple =
-        std::tuple<std::pair<bool, typename OptionResult<Options>::Type>...>;
+    template <std::size_t i>
+    using ResultType = typename OptionResult<
+        std::tuple_element_t<i, std::tuple<Options...>>>::Type;
 
-    ResultSet()
-        : m_results(
-              std::pair(false, typename OptionResult<Options>::Type())...) {}
+    ResultSet() = default;
 
-    template <std::size_t i>
-    std::optional<
-        typename std::tuple_element<i, ResultTuple>::type::second_type>
-    find() const {
-        if (std::get<i>(m_results).first) {
-            return std::get<i>(m_results).second;
+    ResultSet(const ResultSet &other) { copyFrom(other); }
+
+    ResultSet(ResultSet &&other) noexcept(nothrow_move) { moveFrom(other); }
+
+    ResultSet &operator=(const ResultSet &other) {
+        if (this != &other) {
+            clear();
+            copyFrom(other);
+        }
+        return *this;
+    }
+
+    ResultSet &operator=(ResultSet &&other) noexcept(nothrow_move) {
+        if (this != &other) {
+            clear();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    ~ResultSet() { clear(); }
+
+    template <std::size_t i> std::optional<ResultType<i>> find() const {
+        if (m_found[i]) {
+            return slot<i>();
         } else {
             return std::nullopt;
         }
     }
 
+    template <std::size_t i> const ResultType<i> *get() const {
+        return m_found[i] ? &slot<i>() : nullptr;
+    }
+
+    /*
+    Result of the first StaticOption with identifier Name.
+    Example: if (auto r = result_set.get<"-O">()) level = r->get<0>();
+    */
+    template <FixedString Name> const auto *get() const {
+        constexpr std::size_t i = indexOf<Name>();
+        static_assert(i < sizeof...(Options),
+                      "no StaticOption has this identifier");
+        return get<i>();
+    }
+
+    template <std::size_t i> bool contains() const { return m_found[i]; }
+
+    /*
+    Call f(std::integral_constant<std::size_t, i>{}, result) for every option
+    i that was found, in option order.
+    */
+    template <class Func> void visit(Func &&f) const {
+        forEachIndex([&](auto i) {
+            if (m_found[i]) {
+                f(i, slot<i>());
+            }
+        });
+    }
+
 private:
     friend Parser<Options...>;
-    ResultTuple m_results;
+
+    /*
+    Storage of one result, constructed and destroyed by ResultSet.
+    */
+    template <class T> union Slot {
+        Slot() {}
+        ~Slot() {}
+        T value;
+    };
+
+    template <std::size_t i> ResultType<i> &slot() {
+        return std::get<i>(m_slots).value;
+    }
+
+    template <std::size_t i> const ResultType<i> &slot() const {
+        return std::get<i>(m_slots).value;
+    }
+
+    static constexpr bool nothrow_move =
+        (std::is_nothrow_move_constructible_v<
+             typename OptionResult<Options>::Type> &&
+         ...);
+
+    template <class Func> static void forEachIndex(Func &&f) {
+        [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+            (f(std::integral_constant<std::size_t, Is>{}), ...);
+        }(std::make_index_sequence<sizeof...(Options)>{});
+    }
+
+    void copyFrom(const ResultSet &other) {
+        // a constructor that throws does not run ~ResultSet, so the results
+        // copied so far are destroyed here
+        try {
+            forEachIndex([&](auto i) {
+                if (other.m_found[i]) {
+                    std::construct_at(&slot<i>(), other.template slot<i>());
+                    m_found[i] = true;
+                }
+            });
+        } catch (...) {
+            clear();
+            throw;
+        }
+    }
+
+    void moveFrom(ResultSet &other) {
+        // only reached with a throwing move when nothrow_move is false
+        try {
+            forEachIndex([&](auto i) {
+                if (other.m_found[i]) {
+                    std::construct_at(&slot<i>(),
+                                      std::move(other.template slot<i>()));
+                    m_found[i] = true;
+                }
+            });
+        } catch (...) {
+            clear();
+            throw;
+        }
+    }
+
+    void clear() {
+        if (m_found.none())
+            return;
+        forEachIndex([&](auto i) {
+            if (m_found[i]) {
+                std::destroy_at(&slot<i>());
+            }
+        });
+        m_found.reset();
+    }
+
+    template <FixedString Name> static constexpr std::size_t indexOf() {
+        std::size_t index = sizeof...(Options);
+        std::size_t i = 0;
+        (
+            [&]() {
+                if constexpr (IsStaticOption<Options>::value) {
+                    if (index == sizeof...(Options) &&
+                        Options::checkIdentifier(Name.view())) {
+                        index = i;
+                    }
+                }
+                ++i;
+            }(),
+            ...);
+        return index;
+    }
+
+    std::bitset<sizeof...(Options)> m_found;
+    std::tuple<Slot<typename OptionResult<Options>::Type>...> m_slots;
 };
 
 template <class... Options> class Parser {
@@ -327,26 +821,24 @@ public:
         if (input_line.empty())
             return r;
 
-        auto lamb_tup = std::make_tuple(
-            [&](const Options &opt,
-                std::pair<bool, typename OptionResult<Options>::Type> &pair)
-                -> bool {
-                if (!pair.first) {
-                    if (auto r = opt.parse(input_line, delim)) {
-                        pair.first = true;
-                        pair.second = *r;
-                        return true;
-                    } else {
-                        return false;
-                    }
-                } else
-                    return false;
-            }...);
-
         while (!input_line.empty()) {
-            bool found = traverseOptions(
-                lamb_tup, r, std::make_index_sequence<sizeof...(Options)>{});
-            if (!found) {
+            // each word is extracted once and only given to the options it
+            // identifies
+            auto pair = extractFirstWord(input_line, delim);
+            std::string_view rest = input_line.substr(pair.second);
+            bool found = false;
+            if constexpr (all_static) {
+                found = dispatch_table.find(pair.first, [&](std::size_t i) {
+                    return option_parsers[i](r, rest, delim);
+                });
+            } else {
+                found = traverseOptions(
+                    pair.first, r, rest, delim,
+                    std::make_index_sequence<sizeof...(Options)>{});
+            }
+            if (found) {
+                input_line = rest;
+            } else {
                 input_line = removeFirstWord(input_line, delim).first;
             }
         }
@@ -357,15 +849,66 @@ public:
     constexpr const OptionTuple &getOptions() const { return m_options; }
 
 private:
-    template <class LambTup, std::size_t... Is>
-    bool traverseOptions(const LambTup &lamb_tup, ResultSetType &r_set,
+    using OptionParserFunc = bool (*)(ResultSetType &, std::string_view &,
+                                      const std::string_view &);
+
+    static constexpr bool all_static = (IsStaticOption<Options>::value && ...);
+
+    /*
+    Parse the params of option i into r_set, unless it was already found.
+    */
+    template <std::size_t i>
+    static bool parseOption(ResultSetType &r_set, std::string_view &str_view,
+                            const std::string_view &delim) {
+        using OptionType = std::tuple_element_t<i, OptionTuple>;
+        if (r_set.m_found[i])
+            return false;
+        auto *result = std::construct_at(&r_set.template slot<i>());
+        bool parsed = false;
+        try {
+            parsed = OptionType::parseParameters(*result, str_view, delim);
+        } catch (...) {
+            // the slot is not marked found, so ResultSet would not destroy it
+            std::destroy_at(result);
+            throw;
+        }
+        if (!parsed) {
+            std::destroy_at(result);
+            return false;
+        }
+        r_set.m_found[i] = true;
+        return true;
+    }
+
+    template <std::size_t... Is>
+    static constexpr std::array<OptionParserFunc, sizeof...(Options)>
+    makeOptionParsers(std::index_sequence<Is...>) {
+        return {&parseOption<Is>...};
+    }
+
+    static constexpr auto option_parsers =
+        makeOptionParsers(std::make_index_sequence<sizeof...(Options)>{});
+
+    static constexpr auto makeDispatchTable() {
+        if constexpr (all_static) {
+            return DispatchTable<Options...>();
+        } else {
+            return nullptr;
+        }
+    }
+
+    static constexpr auto dispatch_table = makeDispatchTable();
+
+    template <std::size_t... Is>
+    bool traverseOptions(std::string_view word, ResultSetType &r_set,
+                         std::string_view &str_view,
+                         const std::string_view &delim,
                          std::index_sequence<Is...>) const {
         bool found = false;
         (
             [&]() {
-                if (!found) {
-                    found = std::get<Is>(lamb_tup)(
-                        std::get<Is>(m_options), std::get<Is>(r_set.m_results));
+                if (!found && std::get<Is>(m_options).checkIdentifier(word)) {
+                    found = parseOption<Is>(r_set, str_view, delim);
                 }
             }(),
             ...);
@@ -377,4 +920,14 @@ private:
 
 } // namespace OptionParser
 
+template <class... Options>
+struct std::tuple_size<OptionParser::ResultSet<Options...>>
+    : std::integral_constant<std::size_t, sizeof...(Options)> {};
+
+template <std::size_t i, class... Options>
+struct std::tuple_element<i, OptionParser::ResultSet<Options...>> {
+    using type = const typename OptionParser::ResultSet<
+        Options...>::template ResultType<i> *;
+};
+
 #endif // !OptionParser_HEADER
@@ -1,9 +1,30 @@
 
 #include "OptionParser_v2.hpp"
 
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <charconv>
+#include <cstring>
+#include <fstream>
 #include <iostream>
 #include <sstream>
+#include <thread>
+#include <tuple>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define OPTIONPARSER_V2_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OPTIONPARSER_V2_X86_SIMD
+#include <immintrin.h>
+#endif
 
 namespace optionparser_v2 {
 
@@ -33,6 +54,115 @@ std::vector<std::string> defaultSuggestionsFunc(const Component &component,
     return suggestions;
 }
 
+ParameterType::Kind ParameterType::getKind() const { return m_kind; }
+
+std::optional<TypedValue>
+ParameterType::convert(std::string_view token) const {
+    const char *first = token.data();
+    const char *last = token.data() + token.size();
+    switch (m_kind) {
+    case Kind::String:
+        return TypedValue();
+    case Kind::Integer: {
+        std::int64_t value = 0;
+        auto [ptr, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc() || ptr != last || value < m_integer_min ||
+            value > m_integer_max) {
+            return std::nullopt;
+        }
+        return TypedValue(value);
+    }
+    case Kind::Float: {
+        double value = 0;
+        auto [ptr, ec] = std::from_chars(first, last, value);
+        // NaN is never within the bounds
+        if (ec != std::errc() || ptr != last ||
+            !(value >= m_float_min && value <= m_float_max)) {
+            return std::nullopt;
+        }
+        return TypedValue(value);
+    }
+    case Kind::Boolean:
+        if (token == "true" || token == "yes" || token == "on" ||
+            token == "1") {
+            return TypedValue(true);
+        }
+        if (token == "false" || token == "no" || token == "off" ||
+            token == "0") {
+            return TypedValue(false);
+        }
+        return std::nullopt;
+    case Kind::Choice: {
+        auto it = m_choice_set->m_indices.find(token);
+        if (it == m_choice_set->m_indices.end()) {
+            return std::nullopt;
+        }
+        return TypedValue(it->second);
+    }
+    }
+    return std::nullopt;
+}
+
+std::span<const std::string> ParameterType::getChoices() const {
+    if (!m_choice_set) {
+        return {};
+    }
+    return m_choice_set->m_choices;
+}
+
+std::vector<std::string>
+ParameterType::getSuggestions(std::string_view input_token) const {
+    std::vector<std::string> suggestions;
+    auto suggest = [&](std::string_view value) {
+        if (value.starts_with(input_token)) {
+            suggestions.emplace_back(value);
+        }
+    };
+    if (m_kind == Kind::Boolean) {
+        suggest("true");
+        suggest("false");
+    }
+    for (const std::string &choice : getChoices()) {
+        suggest(choice);
+    }
+    return suggestions;
+}
+
+ParameterType makeIntegerType(std::int64_t min, std::int64_t max) {
+    ParameterType parameter_type;
+    parameter_type.m_kind = ParameterType::Kind::Integer;
+    parameter_type.m_integer_min = min;
+    parameter_type.m_integer_max = max;
+    return parameter_type;
+}
+
+ParameterType makeFloatType(double min, double max) {
+    ParameterType parameter_type;
+    parameter_type.m_kind = ParameterType::Kind::Float;
+    parameter_type.m_float_min = min;
+    parameter_type.m_float_max = max;
+    return parameter_type;
+}
+
+ParameterType makeBooleanType() {
+    ParameterType parameter_type;
+    parameter_type.m_kind = ParameterType::Kind::Boolean;
+    return parameter_type;
+}
+
+ParameterType makeChoiceType(std::vector<std::string> choices) {
+    auto choice_set = std::make_shared<ParameterType::ChoiceSet>();
+    choice_set->m_choices = std::move(choices);
+    // the keys view the strings of the shared set, which is never modified
+    for (std::size_t index = 0; index < choice_set->m_choices.size(); ++index) {
+        choice_set->m_indices.emplace(choice_set->m_choices[index], index);
+    }
+    ParameterType parameter_type;
+    parameter_type.m_kind = ParameterType::Kind::Choice;
+    parameter_type.m_choice_set = std::move(choice_set);
+    return parameter_type;
+}
+
 Component::Component(ComponentType type, std::string name,
                      std::string short_name, std::string description,
                      std::vector<Component> &&children,
@@ -96,10 +226,62 @@ std::vector<Component> &Component::getChildrenMutable() { return m_children; }
 
 std::vector<std::string>
 Component::getSuggestions(std::string_view input_token) const {
+    if (m_suggestions_sink_func) {
+        std::vector<std::string> suggestions;
+        m_suggestions_sink_func(*this, input_token,
+                                [&](std::string_view suggestion) {
+                                    suggestions.emplace_back(suggestion);
+                                    return true;
+                                });
+        return suggestions;
+    }
     assert(m_suggestions_func);
     return m_suggestions_func(*this, input_token);
 }
 
+bool Component::getSuggestions(std::string_view input_token,
+                               const SuggestionSink &sink) const {
+    if (m_suggestions_sink_func) {
+        return m_suggestions_sink_func(*this, input_token, sink);
+    }
+    if (hasDefaultSuggestionsFunc()) {
+        // same as defaultSuggestionsFunc, without the vector
+        if (isParameter() || !m_name.starts_with(input_token)) {
+            return true;
+        }
+        return sink(m_name);
+    }
+    assert(m_suggestions_func);
+    for (const auto &suggestion : m_suggestions_func(*this, input_token)) {
+        if (!sink(suggestion)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Component::setSuggestionsSinkFunc(
+    SuggestionsSinkFunc suggestions_sink_func) {
+    m_suggestions_sink_func = std::move(suggestions_sink_func);
+}
+
+const ParameterType &Component::getParameterType() const {
+    return m_parameter_type;
+}
+
+void Component::setParameterType(ParameterType parameter_type) {
+    m_parameter_type = std::move(parameter_type);
+}
+
+bool Component::hasDefaultSuggestionsFunc() const {
+    if (m_suggestions_sink_func) {
+        return false;
+    }
+    using Func = decltype(&defaultSuggestionsFunc);
+    const Func *func = m_suggestions_func.target<Func>();
+    return func != nullptr && *func == &defaultSuggestionsFunc;
+}
+
 Component makeParameter(std::string display_name, std::string description,
                         std::vector<Component> &&children,
                         SuggestionsFunc suggestions_func, bool required) {
@@ -117,6 +299,36 @@ Component makeRequiredParameter(std::string display_name,
                      suggestions_func, true);
 }
 
+std::vector<std::string> typedSuggestionsFunc(const Component &component,
+                                              std::string_view input_token) {
+    return component.getParameterType().getSuggestions(input_token);
+}
+
+Component makeTypedParameter(std::string display_name, std::string description,
+                             ParameterType parameter_type,
+                             std::vector<Component> &&children, bool required) {
+    auto kind = parameter_type.getKind();
+    SuggestionsFunc suggestions_func = defaultSuggestionsFunc;
+    if (kind == ParameterType::Kind::Boolean ||
+        kind == ParameterType::Kind::Choice) {
+        suggestions_func = typedSuggestionsFunc;
+    }
+    Component component(ComponentType::Parameter, std::move(display_name), "",
+                        std::move(description), std::move(children),
+                        suggestions_func, required);
+    component.setParameterType(std::move(parameter_type));
+    return component;
+}
+
+Component makeRequiredTypedParameter(std::string display_name,
+                                     std::string description,
+                                     ParameterType parameter_type,
+                                     std::vector<Component> &&children) {
+    return makeTypedParameter(std::move(display_name), std::move(description),
+                              std::move(parameter_type), std::move(children),
+                              true);
+}
+
 Component makeFlag(std::string name, std::string short_name,
                    std::string description, std::vector<Component> &&parameters,
                    SuggestionsFunc suggestions_func, bool required) {
@@ -168,53 +380,59 @@ std::optional<ParseResult> parseResultFromToken(const Component &component,
                                                 std::string_view token) {
     ParseResult parse_result;
     if (component.isParameter()) {
-        parse_result = ParseResult{std::string(token), &component, {}};
+        // a token that does not convert is not accepted by the parameter
+        auto typed_value = component.getParameterType().convert(token);
+        if (!typed_value.has_value()) {
+            return std::nullopt;
+        }
+        parse_result =
+            ParseResult{std::string(token), &component, {}, *typed_value};
     } else if (component.isFlag()) {
         // check if token matches flag
         if (token != component.getName() && token != component.getShortName()) {
             return std::nullopt;
         }
-        parse_result = ParseResult{std::string(token), &component, {}};
+        parse_result = ParseResult{std::string(token), &component, {}, {}};
     } else if (component.isCommand()) {
         // check if token matches name
         if (token != component.getName()) {
             return std::nullopt;
         }
-        parse_result = ParseResult{std::string(token), &component, {}};
+        parse_result = ParseResult{std::string(token), &component, {}, {}};
     } else {
         assert(false);
     }
     return parse_result;
 }
 
-size_t countParametersInParseResult(const ParseResult &parse_result) {
-    size_t count = 0;
-    // count number of parameters present in children, non recursive
-    for (const auto &child : parse_result.m_children) {
-        if (child.m_component->isParameter()) {
-            ++count;
-        }
-    }
-    return count;
+ParseContext::Frame ParseContext::makeFrame(ParseResult &parse_result) {
+    return Frame{&parse_result, 0, 0, 0};
 }
 
-bool parseResultIsComplete(const ParseResult &parse_result) {
-    // check if the component of the ParseResult have any required child
-    // components that have not been parsed in the result
-    for (const auto &child_component_ref :
-         parse_result.m_component->getChildren()) {
-        const Component &child_component = child_component_ref.get();
-        if (child_component.isRequired()) {
-            bool found = false;
-            for (const auto &child_result : parse_result.m_children) {
-                if (child_result.m_component == &child_component) {
-                    found = true;
-                    break;
-                }
-            }
-            if (!found) {
+bool ParseContext::frameIsComplete(const Frame &frame) {
+    const ParseResult &parse_result = *frame.m_parse_result;
+    const auto &children = parse_result.m_component->m_children;
+    for (std::size_t i = 0; i < children.size(); ++i) {
+        const Component &child_component = children[i];
+        if (!child_component.isRequired()) {
+            continue;
+        }
+        if (i < 64) {
+            if ((frame.m_required_mask & (std::uint64_t(1) << i)) == 0) {
                 return false;
             }
+            continue;
+        }
+        // required children past the mask are looked up in the result
+        bool found = false;
+        for (const auto &child_result : parse_result.m_children) {
+            if (child_result.m_component == &child_component) {
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            return false;
         }
     }
     return true;
@@ -228,7 +446,10 @@ bool ParseContext::parseToken(std::string_view token) {
             auto parse_result = parseResultFromToken(component, token);
             if (parse_result) {
                 m_root_parse_result = std::move(parse_result);
-                m_parse_result_stack.push(&m_root_parse_result.value());
+                if (!component.get().m_children.empty()) {
+                    m_parse_result_stack.push_back(
+                        makeFrame(m_root_parse_result.value()));
+                }
                 return true;
             }
         }
@@ -245,53 +466,72 @@ bool ParseContext::parseToken(std::string_view token) {
     // If we find a token that is not a valid flag, command, or
     // parameter, then stop parsing children and return what we have so far
     while (!m_parse_result_stack.empty()) {
-        ParseResult &parse_result = *m_parse_result_stack.top();
-        const Component &component = *parse_result.m_component;
-
-        if (component.getChildren().empty()) {
-            // if component has no children, then there is nothing to parse
-            return false;
-        }
+        Frame &frame = m_parse_result_stack.back();
+        ParseResult &parse_result = *frame.m_parse_result;
+        const auto &children = parse_result.m_component->m_children;
 
+        // a flag wins over any command, so only the first matching command
+        // is kept while looking for a flag
         std::optional<ParseResult> child_parse_result;
-        for (const Component &flag : component.getFlags()) {
-            child_parse_result = parseResultFromToken(flag, token);
-            if (child_parse_result.has_value()) {
-                break;
-            }
-        }
-
-        if (!child_parse_result.has_value()) {
-            for (const Component &command : component.getCommands()) {
-                child_parse_result = parseResultFromToken(command, token);
+        std::size_t child_position = 0;
+        std::optional<ParseResult> command_parse_result;
+        std::size_t command_position = 0;
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            const Component &child_component = children[i];
+            if (child_component.isFlag()) {
+                child_parse_result =
+                    parseResultFromToken(child_component, token);
                 if (child_parse_result.has_value()) {
+                    child_position = i;
                     break;
                 }
+            } else if (child_component.isCommand() &&
+                       !command_parse_result.has_value()) {
+                command_parse_result =
+                    parseResultFromToken(child_component, token);
+                command_position = i;
             }
         }
+        if (!child_parse_result.has_value() &&
+            command_parse_result.has_value()) {
+            child_parse_result = std::move(command_parse_result);
+            child_position = command_position;
+        }
 
         if (!child_parse_result.has_value()) {
-            // if we have found all parameters, then we are done
-            size_t parameter_count = countParametersInParseResult(parse_result);
-            if (parameter_count < component.getParameters().size()) {
-                child_parse_result = parseResultFromToken(
-                    component.getParameters()[parameter_count], token);
+            // the next parameter, if not all of them have been found; the
+            // frame remembers where the scan for it stopped
+            while (frame.m_next_parameter < children.size() &&
+                   !children[frame.m_next_parameter].isParameter()) {
+                ++frame.m_next_parameter;
+            }
+            if (frame.m_next_parameter < children.size()) {
+                child_position = frame.m_next_parameter;
+                child_parse_result =
+                    parseResultFromToken(children[child_position], token);
             }
         }
 
         if (child_parse_result.has_value()) {
+            const Component &child_component = children[child_position];
+            if (child_component.isParameter()) {
+                ++frame.m_parameter_count;
+                frame.m_next_parameter = child_position + 1;
+            }
+            if (child_component.isRequired() && child_position < 64) {
+                frame.m_required_mask |= std::uint64_t(1) << child_position;
+            }
             parse_result.m_children.push_back(
                 std::move(child_parse_result.value()));
             // if child has children, then push it onto the stack
-            if (!parse_result.m_children.back()
-                     .m_component->getChildren()
-                     .empty()) {
-                m_parse_result_stack.push(&parse_result.m_children.back());
+            if (!child_component.m_children.empty()) {
+                m_parse_result_stack.push_back(
+                    makeFrame(parse_result.m_children.back()));
             }
             return true;
         }
 
-        if (!parseResultIsComplete(parse_result)) {
+        if (!frameIsComplete(frame)) {
             // if we have not found all required child components, then we
             // cannot pop as the current parse result is not complete
             return false;
@@ -300,18 +540,15 @@ bool ParseContext::parseToken(std::string_view token) {
         // if we didn't match any child component, all parameters are
         // consumed and there are no outstanding required components, pop the
         // stack
-        m_parse_result_stack.pop();
+        m_parse_result_stack.pop_back();
     }
     return false;
 }
 
-std::vector<std::string>
-nextTokenSuggestionsParseResult(const ParseResult &parse_result,
-                                std::string_view token) {
-
-    std::vector<std::string> suggestions;
-
-    size_t result_parameter_count = countParametersInParseResult(parse_result);
+bool nextTokenSuggestionsParseResult(const ParseResult &parse_result,
+                                     size_t result_parameter_count,
+                                     std::string_view token,
+                                     const SuggestionSink &sink) {
     size_t component_parameter_count =
         parse_result.m_component->getParameters().size();
 
@@ -325,40 +562,52 @@ nextTokenSuggestionsParseResult(const ParseResult &parse_result,
             continue;
         }
 
-        auto child_suggestions = child_component.getSuggestions(token);
-        suggestions.insert(suggestions.end(), child_suggestions.begin(),
-                           child_suggestions.end());
+        if (!child_component.getSuggestions(token, sink)) {
+            return false;
+        }
     }
-
-    return suggestions;
+    return true;
 }
 
 std::vector<std::string>
 ParseContext::getNextSuggestions(std::string_view token) const {
+    std::vector<std::string> suggestions;
+    getNextSuggestions(token, [&](std::string_view suggestion) {
+        suggestions.emplace_back(suggestion);
+        return true;
+    });
+    return suggestions;
+}
+
+bool ParseContext::getNextSuggestions(std::string_view token,
+                                      const SuggestionSink &sink) const {
     if (m_parse_result_stack.empty()) {
         if (m_root_parse_result.has_value()) {
-            return {};
+            return true;
         }
         // if we have no parse result, then suggest next token based on root
         // components
-        std::vector<std::string> suggestions;
         for (const auto &root_component : m_root_components) {
-            auto root_component_suggestions =
-                root_component.get().getSuggestions(token);
-            suggestions.insert(suggestions.end(),
-                               root_component_suggestions.begin(),
-                               root_component_suggestions.end());
+            if (!root_component.get().getSuggestions(token, sink)) {
+                return false;
+            }
         }
-        return suggestions;
+        return true;
     }
-    const ParseResult &parse_result = *m_parse_result_stack.top();
-    return nextTokenSuggestionsParseResult(parse_result, token);
+    const Frame &frame = m_parse_result_stack.back();
+    return nextTokenSuggestionsParseResult(
+        *frame.m_parse_result, frame.m_parameter_count, token, sink);
 }
 
 const std::optional<ParseResult> &ParseContext::getRootParseResult() const {
     return m_root_parse_result;
 }
 
+std::optional<ParseResult> ParseContext::takeRootParseResult() {
+    m_parse_result_stack = {};
+    return std::exchange(m_root_parse_result, std::nullopt);
+}
+
 bool ParseContext::isComplete() const {
     if (!m_root_parse_result.has_value()) {
         return false;
@@ -366,266 +615,2430 @@ bool ParseContext::isComplete() const {
     if (m_parse_result_stack.empty()) {
         return true;
     }
-    return parseResultIsComplete(*m_parse_result_stack.top());
+    return frameIsComplete(m_parse_result_stack.back());
 }
 
-std::vector<std::string_view> tokenize(std::string_view input_string) {
-    std::vector<std::string_view> tokens;
-
-    size_t startPos = 0;
-    size_t endPos = 0;
-    bool insideQuotes = false;
-    bool escaped = false;
-
-    while (endPos < input_string.length()) {
-        if (input_string[endPos] == '"' && !escaped) {
-            insideQuotes = !insideQuotes;
-        }
-
-        if (input_string[endPos] == '\\' && !escaped) {
-            escaped = true;
-        } else {
-            escaped = false;
-        }
+ParseContext::Checkpoint ParseContext::checkpoint() const {
+    Checkpoint checkpoint;
+    checkpoint.m_has_root = m_root_parse_result.has_value();
+    if (!checkpoint.m_has_root) {
+        return checkpoint;
+    }
+    // results are only ever appended to the top of the stack, so the stack is
+    // always the first results on the path of last children from the root
+    for (const Frame &frame : m_parse_result_stack) {
+        checkpoint.m_child_counts.push_back(
+            frame.m_parse_result->m_children.size());
+    }
+    checkpoint.m_stack = m_parse_result_stack;
+    return checkpoint;
+}
 
-        if (!insideQuotes && input_string[endPos] == ' ' && !escaped) {
-            if (endPos > startPos) {
-                tokens.push_back(
-                    input_string.substr(startPos, endPos - startPos));
-            }
-            startPos = endPos + 1;
+void ParseContext::rollback(const Checkpoint &checkpoint) {
+    m_parse_result_stack = {};
+    if (!checkpoint.m_has_root) {
+        m_root_parse_result.reset();
+        return;
+    }
+    assert(m_root_parse_result.has_value());
+    // everything parsed since the checkpoint hangs off the results that were
+    // on the stack, drop it and push those results again with their counters
+    ParseResult *parse_result = &m_root_parse_result.value();
+    for (std::size_t depth = 0; depth < checkpoint.m_child_counts.size();
+         ++depth) {
+        auto &children = parse_result->m_children;
+        children.erase(children.begin() + checkpoint.m_child_counts[depth],
+                       children.end());
+        Frame frame = checkpoint.m_stack[depth];
+        frame.m_parse_result = parse_result;
+        m_parse_result_stack.push_back(frame);
+        if (!children.empty()) {
+            parse_result = &children.back();
         }
-
-        ++endPos;
     }
+}
 
-    // Handle the last word if it's not followed by a space
-    if (endPos > startPos) {
-        tokens.push_back(input_string.substr(startPos, endPos - startPos));
+// breadth first, so the children of every node end up contiguous
+std::vector<CompiledGrammar::SourceNode> flattenComponents(
+    const std::vector<std::reference_wrapper<const Component>>
+        &root_components) {
+    std::vector<CompiledGrammar::SourceNode> sources;
+    auto append_source = [&](const Component &component) {
+        sources.push_back(CompiledGrammar::SourceNode{
+            &component, component.getType(), component.isRequired(),
+            component.hasDefaultSuggestionsFunc(),
+            component.getParameterType().getKind() !=
+                ParameterType::Kind::String,
+            component.getName(), component.getShortName(), 0, 0});
+    };
+    for (const auto &root_component : root_components) {
+        append_source(root_component.get());
     }
-
-    // Remove quotes from tokens, if any
-    for (auto &token : tokens) {
-        if (token.length() >= 2 && token.front() == '"' &&
-            token.back() == '"') {
-            token = token.substr(1, token.length() - 2);
+    for (std::size_t index = 0; index < sources.size(); ++index) {
+        const auto children = sources[index].m_component->getChildren();
+        CompiledGrammar::NodeIndex children_begin = sources.size();
+        for (const Component &child : children) {
+            append_source(child);
         }
+        sources[index].m_children_begin = children_begin;
+        sources[index].m_children_end = sources.size();
     }
+    return sources;
+}
 
-    return tokens;
+CompiledGrammar::CompiledGrammar(
+    const std::vector<std::reference_wrapper<const Component>>
+        &root_components,
+    NameMatching name_matching)
+    : m_name_matching(name_matching) {
+    auto storage = std::make_shared<const TableBuilder>(
+        flattenComponents(root_components),
+        static_cast<NodeIndex>(root_components.size()));
+    m_tables = storage->getTables();
+    m_storage = std::move(storage);
 }
 
-std::optional<ParseResult> parseMultiImpl(
-    const std::vector<std::reference_wrapper<const Component>> &root_components,
-    std::string_view input_string) {
+CompiledGrammar::CompiledGrammar(const std::vector<Component> &root_components,
+                                 NameMatching name_matching)
+    : CompiledGrammar(std::vector<std::reference_wrapper<const Component>>(
+                          root_components.begin(), root_components.end()),
+                      name_matching) {}
+
+CompiledGrammar::CompiledGrammar(const Component &root_component,
+                                 NameMatching name_matching)
+    : CompiledGrammar(std::vector<std::reference_wrapper<const Component>>{
+                          std::ref(root_component)},
+                      name_matching) {}
+
+CompiledGrammar::CompiledGrammar(const Tables &tables,
+                                 NameMatching name_matching)
+    : m_tables(tables), m_name_matching(name_matching) {}
+
+CompiledGrammar::CompiledGrammar(const Tables &tables,
+                                 std::shared_ptr<const void> storage,
+                                 NameMatching name_matching)
+    : m_tables(tables), m_storage(std::move(storage)),
+      m_name_matching(name_matching) {}
+
+const CompiledGrammar::Tables &CompiledGrammar::getTables() const {
+    return m_tables;
+}
 
-    // tokenize input_string
-    std::vector<std::string_view> tokens = tokenize(input_string);
+const CompiledGrammar::SuggestionIndex &
+CompiledGrammar::getSuggestionIndex(NodeIndex index) const {
+    if (index == npos) {
+        return m_tables.m_root_suggestions;
+    }
+    assert(index < m_tables.m_nodes.size());
+    return m_tables.m_nodes[index].m_suggestions;
+}
 
-    ParseContext parse_context(root_components);
-    for (const auto &token : tokens) {
-        if (!parse_context.parseToken(token)) {
+std::optional<CompiledGrammar::NodeIndex>
+CompiledGrammar::findInTrie(std::uint32_t trie, std::string_view token,
+                            NameMatching name_matching) const {
+    if (trie == npos) {
+        return std::nullopt;
+    }
+    const auto trie_nodes = m_tables.m_trie_nodes;
+    const TrieNode *node = &trie_nodes[trie];
+    for (char c : token) {
+        const TrieNode *children_begin =
+            trie_nodes.data() + node->m_children_begin;
+        const TrieNode *children_end = trie_nodes.data() + node->m_children_end;
+        const TrieNode *child = std::lower_bound(
+            children_begin, children_end, static_cast<unsigned char>(c),
+            [](const TrieNode &lhs, unsigned char rhs) {
+                return lhs.m_label < rhs;
+            });
+        if (child == children_end ||
+            child->m_label != static_cast<unsigned char>(c)) {
             return std::nullopt;
         }
+        node = child;
+    }
+
+    if (node->m_terminal != npos) {
+        return node->m_terminal;
     }
-    return parse_context.getRootParseResult();
+    if (name_matching == NameMatching::UniquePrefix && !token.empty() &&
+        node->m_unique != npos) {
+        return node->m_unique;
+    }
+    return std::nullopt;
 }
 
-std::optional<ParseResult> parseMultiRef(
-    const std::vector<std::reference_wrapper<const Component>> &root_components,
-    std::string_view input_string) {
-    return parseMultiImpl(root_components, input_string);
+std::span<const CompiledGrammar::Node> CompiledGrammar::getNodes() const {
+    return m_tables.m_nodes;
 }
 
-std::optional<ParseResult>
-parseMulti(const std::vector<Component> &root_components,
-           std::string_view input_string) {
-    std::vector<std::reference_wrapper<const Component>> root_component_refs;
-    for (const auto &root_component : root_components) {
-        root_component_refs.push_back(std::ref(root_component));
-    }
-    return parseMultiRef(root_component_refs, input_string);
+const CompiledGrammar::Node &CompiledGrammar::getNode(NodeIndex index) const {
+    assert(index < m_tables.m_nodes.size());
+    return m_tables.m_nodes[index];
 }
 
-std::optional<ParseResult> parse(const Component &root_component,
-                                 std::string_view input_string) {
-    return parseMultiImpl({std::ref(root_component)}, input_string);
+std::span<const CompiledGrammar::Node> CompiledGrammar::getRoots() const {
+    return getNodes().subspan(0, m_tables.m_root_count);
 }
 
-const ParseResult &getLastParseResult(const ParseResult &parse_result) {
-    if (parse_result.m_children.empty()) {
-        return parse_result;
-    }
-    return getLastParseResult(parse_result.m_children.back());
+std::span<const CompiledGrammar::Node>
+CompiledGrammar::getChildren(NodeIndex index) const {
+    const Node &node = getNode(index);
+    return getNodes().subspan(node.m_children_begin,
+                              node.m_children_end - node.m_children_begin);
 }
 
-std::vector<std::string> nextTokenSuggestionsMultiImpl(
-    const std::vector<std::reference_wrapper<const Component>> &root_components,
-    const std::string_view &input_string) {
+std::span<const CompiledGrammar::NodeIndex>
+CompiledGrammar::getFlags(NodeIndex index) const {
+    const Node &node = getNode(index);
+    return m_tables.m_edges.subspan(node.m_flags_begin,
+                                    node.m_commands_begin - node.m_flags_begin);
+}
 
-    // tokenize input_string
-    std::vector<std::string_view> tokens = tokenize(input_string);
+std::span<const CompiledGrammar::NodeIndex>
+CompiledGrammar::getCommands(NodeIndex index) const {
+    const Node &node = getNode(index);
+    return m_tables.m_edges.subspan(
+        node.m_commands_begin, node.m_parameters_begin - node.m_commands_begin);
+}
 
-    ParseContext parse_context(root_components);
-    auto it = std::begin(tokens);
-    for (; it != std::end(tokens); ++it) {
-        // if the last token maches the end of the input_string, don't parse it
+std::span<const CompiledGrammar::NodeIndex>
+CompiledGrammar::getParameters(NodeIndex index) const {
+    const Node &node = getNode(index);
+    return m_tables.m_edges.subspan(
+        node.m_parameters_begin,
+        node.m_parameters_end - node.m_parameters_begin);
+}
 
-        if (it == std::end(tokens) - 1 && input_string.ends_with(*it)) {
-            break;
-        }
+std::string_view CompiledGrammar::getName(NodeIndex index) const {
+    const Node &node = getNode(index);
+    return m_tables.m_strings.substr(node.m_name_offset, node.m_name_size);
+}
 
-        if (!parse_context.parseToken(*it)) {
-            break;
-        }
-    }
-    if (it != std::end(tokens)) {
-        // if parse failed, suggest next token based on last token and
-        // root_component
-        return parse_context.getNextSuggestions(*it);
-    }
-    return parse_context.getNextSuggestions();
+std::string_view CompiledGrammar::getShortName(NodeIndex index) const {
+    const Node &node = getNode(index);
+    return m_tables.m_strings.substr(node.m_short_name_offset,
+                                     node.m_short_name_size);
 }
 
-std::vector<std::string> nextTokenSuggestionsMultiRef(
-    const std::vector<std::reference_wrapper<const Component>> &root_components,
-    const std::string_view &input_string) {
-    return nextTokenSuggestionsMultiImpl(root_components, input_string);
+std::size_t CompiledGrammar::getMaxDepth() const {
+    return m_tables.m_max_depth;
 }
 
-std::vector<std::string>
-nextTokenSuggestionsMulti(const std::vector<Component> &root_components,
-                          const std::string_view &input_string) {
+CompiledGrammar::NameMatching CompiledGrammar::getNameMatching() const {
+    return m_name_matching;
+}
 
-    std::vector<std::reference_wrapper<const Component>> root_component_refs;
-    for (const auto &root_component : root_components) {
-        root_component_refs.push_back(std::ref(root_component));
-    }
-    return nextTokenSuggestionsMultiRef(root_component_refs, input_string);
+std::optional<CompiledGrammar::NodeIndex>
+CompiledGrammar::findFlag(NodeIndex index, std::string_view token,
+                          NameMatching name_matching) const {
+    return findInTrie(getNode(index).m_flag_trie, token, name_matching);
 }
 
-std::vector<std::string>
-nextTokenSuggestions(const Component &root_component,
-                     const std::string_view &input_string) {
-    return nextTokenSuggestionsMultiImpl({std::ref(root_component)},
-                                         input_string);
+std::optional<CompiledGrammar::NodeIndex>
+CompiledGrammar::findCommand(NodeIndex index, std::string_view token,
+                             NameMatching name_matching) const {
+    return findInTrie(getNode(index).m_command_trie, token, name_matching);
 }
 
-std::string serializeResult(const ParseResult &result) {
-    std::string output_string;
+std::span<const CompiledGrammar::NodeIndex>
+CompiledGrammar::findNamesWithPrefix(NodeIndex index,
+                                     std::string_view prefix) const {
+    const SuggestionIndex &suggestions = getSuggestionIndex(index);
+    auto begin = m_tables.m_name_index.begin() + suggestions.m_names_begin;
+    auto end = m_tables.m_name_index.begin() + suggestions.m_names_end;
+    // names starting with prefix are one contiguous run of the sorted names,
+    // beginning at the first name not less than prefix
+    begin = std::partition_point(begin, end, [&](NodeIndex node) {
+        return getName(node) < prefix;
+    });
+    end = std::partition_point(begin, end, [&](NodeIndex node) {
+        return getName(node).starts_with(prefix);
+    });
+    return {begin, end};
+}
+
+std::vector<CompiledGrammar::SimilarName>
+CompiledGrammar::findSimilarNames(NodeIndex index, std::string_view token,
+                                  std::size_t max_distance) const {
+    std::vector<SimilarName> similar_names;
+    std::uint32_t root = index == npos ? m_tables.m_root_bk_tree
+                                       : getNode(index).m_name_bk_tree;
+    if (root == npos) {
+        return similar_names;
+    }
 
-    output_string += result.m_value;
+    const auto bk_tree_nodes = m_tables.m_bk_tree_nodes;
+    std::vector<std::size_t> row;
+    std::vector<std::uint32_t> pending = {root};
+    while (!pending.empty()) {
+        const BkTreeNode &bk_node = bk_tree_nodes[pending.back()];
+        pending.pop_back();
+
+        std::string_view name = m_tables.m_strings.substr(
+            bk_node.m_name_offset, bk_node.m_name_size);
+        std::size_t distance = editDistance(token, name, row);
+        if (distance <= max_distance) {
+            similar_names.push_back(SimilarName{bk_node.m_node, name, distance});
+        }
 
-    for (const auto &child : result.m_children) {
-        output_string += " ";
-        output_string += serializeResult(child);
+        // by the triangle inequality only children whose distance to this
+        // node is within max_distance of distance can hold a match
+        std::size_t low = distance > max_distance ? distance - max_distance : 0;
+        std::size_t high = distance + max_distance;
+        auto children_begin = bk_tree_nodes.begin() + bk_node.m_children_begin;
+        auto children_end = bk_tree_nodes.begin() + bk_node.m_children_end;
+        auto first = std::partition_point(
+            children_begin, children_end,
+            [&](const BkTreeNode &child) { return child.m_distance < low; });
+        for (auto child = first;
+             child != children_end && child->m_distance <= high; ++child) {
+            pending.push_back(child - bk_tree_nodes.begin());
+        }
     }
 
-    return output_string;
+    // keep the closest name of every component, the name before the short
+    // name on ties
+    auto is_long_name = [&](const SimilarName &similar_name) {
+        return similar_name.m_name.data() == getName(similar_name.m_node).data();
+    };
+    std::sort(similar_names.begin(), similar_names.end(),
+              [&](const SimilarName &a, const SimilarName &b) {
+                  return std::make_tuple(a.m_node, a.m_distance,
+                                         !is_long_name(a)) <
+                         std::make_tuple(b.m_node, b.m_distance,
+                                         !is_long_name(b));
+              });
+    similar_names.erase(
+        std::unique(similar_names.begin(), similar_names.end(),
+                    [](const SimilarName &a, const SimilarName &b) {
+                        return a.m_node == b.m_node;
+                    }),
+        similar_names.end());
+    std::stable_sort(similar_names.begin(), similar_names.end(),
+                     [](const SimilarName &a, const SimilarName &b) {
+                         return a.m_distance < b.m_distance;
+                     });
+    return similar_names;
 }
 
-void generateUsageStringImpl(std::stringstream &ss, const Component &component,
-                             bool skip_square_brackets = false) {
-    if (!component.isRequired() && !skip_square_brackets) {
-        ss << "[";
-    }
+std::span<const CompiledGrammar::NodeIndex>
+CompiledGrammar::getCustomSuggestions(NodeIndex index) const {
+    const SuggestionIndex &suggestions = getSuggestionIndex(index);
+    return m_tables.m_custom_suggestions.subspan(
+        suggestions.m_custom_begin,
+        suggestions.m_custom_end - suggestions.m_custom_begin);
+}
 
-    if (component.isParameter()) {
-        ss << "<" << component.getName() << ">";
-    } else if (component.isFlag()) {
-        ss << component.getName();
-    } else if (component.isCommand()) {
-        ss << component.getName();
-    } else {
-        assert(false);
+std::optional<CompiledGrammar::NodeIndex>
+CompiledGrammar::findRoot(std::string_view token) const {
+    // only roots before the first parameter root are in the trie
+    auto root = findInTrie(m_tables.m_root_trie, token, m_name_matching);
+    if (root.has_value()) {
+        return root;
     }
-
-    const auto children = component.getChildren();
-    int n_child = children.size();
-    if (!children.empty()) {
-        ss << " ";
+    NodeIndex first = m_tables.m_first_parameter_root;
+    if (first == npos) {
+        return std::nullopt;
     }
-
-    // flags
-    for (const auto &flag : component.getFlags()) {
-        generateUsageStringImpl(ss, flag.get());
-        if (--n_child > 0) {
-            ss << " ";
+    if (convertParameter(first, token).has_value()) {
+        return first;
+    }
+    // a typed parameter root rejected token, try the roots after it in order
+    for (NodeIndex index = first + 1; index < m_tables.m_root_count; ++index) {
+        const Node &node = getNode(index);
+        bool matches = false;
+        switch (node.m_type) {
+        case ComponentType::Parameter:
+            matches = convertParameter(index, token).has_value();
+            break;
+        case ComponentType::Flag:
+            matches = token == getName(index) || token == getShortName(index);
+            break;
+        case ComponentType::Command:
+            matches = token == getName(index);
+            break;
+        }
+        if (matches) {
+            return index;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<TypedValue>
+CompiledGrammar::convertParameter(NodeIndex index,
+                                  std::string_view token) const {
+    const Node &node = getNode(index);
+    // nodes without a component, of a StaticGrammar or a loaded grammar file,
+    // are untyped whatever the tables say
+    if (!node.m_typed || node.m_component == nullptr) {
+        return TypedValue();
+    }
+    return node.m_component->getParameterType().convert(token);
+}
+
+// Layout of the binary grammar format. The header is followed by the
+// sections, each aligned for its element type. Sizes of sections are in
+// elements.
+constexpr char grammar_file_magic[8] = {'O', 'P', 'G', 'R',
+                                        'A', 'M', 'M', 'R'};
+// version 2 added CompiledGrammar::Node::m_typed
+constexpr std::uint32_t grammar_file_version = 2;
+constexpr std::uint32_t grammar_file_byte_order = 0x01020304;
+
+struct GrammarFileSection {
+    std::uint64_t m_offset;
+    std::uint64_t m_size;
+};
+
+struct GrammarFileHeader {
+    char m_magic[8];
+    std::uint32_t m_version;
+    std::uint32_t m_byte_order;
+    // struct sizes of the writer, files are only read with the same layout
+    std::uint32_t m_node_size;
+    std::uint32_t m_trie_node_size;
+    std::uint32_t m_bk_tree_node_size;
+    std::uint32_t m_root_count;
+    std::uint32_t m_root_trie;
+    std::uint32_t m_root_bk_tree;
+    std::uint32_t m_first_parameter_root;
+    std::uint32_t m_reserved;
+    CompiledGrammar::SuggestionIndex m_root_suggestions;
+    std::uint64_t m_max_depth;
+    GrammarFileSection m_nodes;
+    GrammarFileSection m_edges;
+    GrammarFileSection m_strings;
+    GrammarFileSection m_trie_nodes;
+    GrammarFileSection m_bk_tree_nodes;
+    GrammarFileSection m_name_index;
+};
+
+std::string serializeGrammar(
+    const std::vector<std::reference_wrapper<const Component>>
+        &root_components) {
+    // pointers and functions cannot be stored, every flag and command is
+    // suggested from the name index instead, and parameters are untyped
+    std::vector<CompiledGrammar::SourceNode> sources =
+        flattenComponents(root_components);
+    for (auto &source : sources) {
+        source.m_component = nullptr;
+        source.m_default_suggestions = true;
+        source.m_typed = false;
+    }
+    const CompiledGrammar::TableBuilder builder(
+        sources, static_cast<CompiledGrammar::NodeIndex>(root_components.size()));
+    const CompiledGrammar::Tables tables = builder.getTables();
+
+    GrammarFileHeader header{};
+    std::memcpy(header.m_magic, grammar_file_magic, sizeof(header.m_magic));
+    header.m_version = grammar_file_version;
+    header.m_byte_order = grammar_file_byte_order;
+    header.m_node_size = sizeof(CompiledGrammar::Node);
+    header.m_trie_node_size = sizeof(CompiledGrammar::TrieNode);
+    header.m_bk_tree_node_size = sizeof(CompiledGrammar::BkTreeNode);
+    header.m_root_count = tables.m_root_count;
+    header.m_root_trie = tables.m_root_trie;
+    header.m_root_bk_tree = tables.m_root_bk_tree;
+    header.m_first_parameter_root = tables.m_first_parameter_root;
+    header.m_root_suggestions = tables.m_root_suggestions;
+    header.m_max_depth = tables.m_max_depth;
+
+    std::string data(sizeof(GrammarFileHeader), '\0');
+    auto append_section = [&](GrammarFileSection &section, auto elements) {
+        using Element = typename decltype(elements)::value_type;
+        constexpr std::size_t alignment = alignof(Element);
+        data.resize((data.size() + alignment - 1) / alignment * alignment,
+                    '\0');
+        section.m_offset = data.size();
+        section.m_size = elements.size();
+        data.append(reinterpret_cast<const char *>(elements.data()),
+                    elements.size_bytes());
+    };
+    append_section(header.m_nodes, tables.m_nodes);
+    append_section(header.m_edges, tables.m_edges);
+    append_section(header.m_strings, std::span<const char>(tables.m_strings));
+    append_section(header.m_trie_nodes, tables.m_trie_nodes);
+    append_section(header.m_bk_tree_nodes, tables.m_bk_tree_nodes);
+    append_section(header.m_name_index, tables.m_name_index);
+    std::memcpy(data.data(), &header, sizeof(header));
+    return data;
+}
+
+std::string serializeGrammar(const std::vector<Component> &root_components) {
+    return serializeGrammar(std::vector<std::reference_wrapper<const Component>>(
+        root_components.begin(), root_components.end()));
+}
+
+std::string serializeGrammar(const Component &root_component) {
+    return serializeGrammar(std::vector<std::reference_wrapper<const Component>>{
+        std::ref(root_component)});
+}
+
+std::optional<CompiledGrammar::Tables> readGrammarTables(std::string_view data) {
+    GrammarFileHeader header;
+    if (data.size() < sizeof(header) ||
+        reinterpret_cast<std::uintptr_t>(data.data()) %
+                alignof(CompiledGrammar::Node) !=
+            0) {
+        return std::nullopt;
+    }
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (std::memcmp(header.m_magic, grammar_file_magic,
+                    sizeof(header.m_magic)) != 0 ||
+        header.m_version != grammar_file_version ||
+        header.m_byte_order != grammar_file_byte_order ||
+        header.m_node_size != sizeof(CompiledGrammar::Node) ||
+        header.m_trie_node_size != sizeof(CompiledGrammar::TrieNode) ||
+        header.m_bk_tree_node_size != sizeof(CompiledGrammar::BkTreeNode)) {
+        return std::nullopt;
+    }
+
+    bool valid = true;
+    auto get_section = [&]<class Element>(const GrammarFileSection &section,
+                                          std::type_identity<Element>) {
+        if (section.m_offset % alignof(Element) != 0 ||
+            section.m_offset > data.size() ||
+            section.m_size > (data.size() - section.m_offset) / sizeof(Element)) {
+            valid = false;
+            return std::span<const Element>();
+        }
+        return std::span<const Element>(
+            reinterpret_cast<const Element *>(data.data() + section.m_offset),
+            section.m_size);
+    };
+    using NodeIndex = CompiledGrammar::NodeIndex;
+    CompiledGrammar::Tables tables{};
+    tables.m_nodes = get_section(header.m_nodes,
+                                 std::type_identity<CompiledGrammar::Node>());
+    tables.m_edges =
+        get_section(header.m_edges, std::type_identity<NodeIndex>());
+    auto strings = get_section(header.m_strings, std::type_identity<char>());
+    tables.m_strings = std::string_view(strings.data(), strings.size());
+    tables.m_trie_nodes = get_section(
+        header.m_trie_nodes, std::type_identity<CompiledGrammar::TrieNode>());
+    tables.m_bk_tree_nodes =
+        get_section(header.m_bk_tree_nodes,
+                    std::type_identity<CompiledGrammar::BkTreeNode>());
+    tables.m_name_index =
+        get_section(header.m_name_index, std::type_identity<NodeIndex>());
+    tables.m_root_suggestions = header.m_root_suggestions;
+    tables.m_root_count = header.m_root_count;
+    tables.m_root_trie = header.m_root_trie;
+    tables.m_root_bk_tree = header.m_root_bk_tree;
+    tables.m_first_parameter_root = header.m_first_parameter_root;
+    tables.m_max_depth = header.m_max_depth;
+    if (!valid || tables.m_root_count > tables.m_nodes.size()) {
+        return std::nullopt;
+    }
+    return tables;
+}
+
+std::optional<CompiledGrammar>
+loadGrammar(std::string_view data,
+            CompiledGrammar::NameMatching name_matching) {
+    auto tables = readGrammarTables(data);
+    if (!tables.has_value()) {
+        return std::nullopt;
+    }
+    return CompiledGrammar(*tables, name_matching);
+}
+
+std::optional<CompiledGrammar>
+mapGrammarFile(const std::string &path,
+               CompiledGrammar::NameMatching name_matching) {
+#ifdef OPTIONPARSER_V2_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+    struct stat file_stat;
+    if (::fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+        ::close(fd);
+        return std::nullopt;
+    }
+    std::size_t size = file_stat.st_size;
+    void *address = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        return std::nullopt;
+    }
+    std::shared_ptr<const void> storage(
+        address, [size](const void *mapped) {
+            ::munmap(const_cast<void *>(mapped), size);
+        });
+    std::string_view data(static_cast<const char *>(address), size);
+#else
+    // no mmap, read the file into memory owned by the grammar
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return std::nullopt;
+    }
+    auto contents = std::make_shared<const std::string>(
+        std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    std::string_view data(*contents);
+    std::shared_ptr<const void> storage = std::move(contents);
+#endif
+    auto tables = readGrammarTables(data);
+    if (!tables.has_value()) {
+        return std::nullopt;
+    }
+    return CompiledGrammar(*tables, std::move(storage), name_matching);
+}
+
+FlatParseResult::FlatParseResult(std::pmr::memory_resource *resource)
+    : m_nodes(resource), m_text(resource) {}
+
+FlatParseResult::Index FlatParseResult::addNode(Index parent,
+                                               const Component *component,
+                                               std::string_view value,
+                                               std::uint32_t grammar_node,
+                                               TypedValue typed_value) {
+    assert((parent == npos) == m_nodes.empty());
+    Index index = m_nodes.size();
+    m_nodes.push_back(Node{component, static_cast<std::uint32_t>(m_text.size()),
+                           static_cast<std::uint32_t>(value.size()), npos, npos,
+                           npos, grammar_node, typed_value});
+    m_text += value;
+    if (parent != npos) {
+        Node &parent_node = m_nodes[parent];
+        if (parent_node.m_last_child == npos) {
+            parent_node.m_first_child = index;
+        } else {
+            m_nodes[parent_node.m_last_child].m_next_sibling = index;
+        }
+        parent_node.m_last_child = index;
+    }
+    return index;
+}
+
+void FlatParseResult::reserve(std::size_t node_count, std::size_t text_size) {
+    m_nodes.reserve(node_count);
+    m_text.reserve(text_size);
+}
+
+bool FlatParseResult::empty() const { return m_nodes.empty(); }
+
+FlatParseResult::NodeRef FlatParseResult::getRoot() const {
+    assert(!m_nodes.empty());
+    return NodeRef(this, 0);
+}
+
+FlatParseResult::NodeRef FlatParseResult::getNode(Index index) const {
+    assert(index < m_nodes.size());
+    return NodeRef(this, index);
+}
+
+std::span<const FlatParseResult::Node> FlatParseResult::getNodes() const {
+    return m_nodes;
+}
+
+std::string_view FlatParseResult::getValue(Index index) const {
+    const Node &node = m_nodes[index];
+    return std::string_view(m_text).substr(node.m_value_offset,
+                                           node.m_value_size);
+}
+
+ResultPath::ResultPath(std::vector<const Component *> components)
+    : m_components(std::move(components)) {}
+
+std::span<const Component *const> ResultPath::getComponents() const {
+    return m_components;
+}
+
+std::optional<ResultPath> makeResultPath(const Component &root_component,
+                                         std::string_view path) {
+    std::vector<const Component *> components;
+    const Component *current = nullptr;
+    while (true) {
+        const std::size_t end = path.find('/');
+        const std::string_view segment = path.substr(0, end);
+        const Component *next = nullptr;
+        if (current == nullptr) {
+            if (segment == root_component.getName()) {
+                next = &root_component;
+            }
+        } else {
+            for (const Component &child : current->getChildren()) {
+                if (segment == child.getName() ||
+                    (!child.getShortName().empty() &&
+                     segment == child.getShortName())) {
+                    next = &child;
+                    break;
+                }
+            }
+        }
+        if (next == nullptr) {
+            return std::nullopt;
+        }
+        components.push_back(next);
+        current = next;
+        if (end == std::string_view::npos) {
+            break;
+        }
+        path.remove_prefix(end + 1);
+    }
+    return ResultPath(std::move(components));
+}
+
+template <class Result>
+std::size_t
+BasicParseResultIndex<Result>::KeyHash::operator()(const Key &key) const {
+    const std::size_t parent = std::hash<const void *>()(key.first);
+    const std::size_t component = std::hash<const void *>()(key.second);
+    return parent ^ (component + 0x9e3779b97f4a7c15ull + (parent << 6) +
+                     (parent >> 2));
+}
+
+template <class Result>
+BasicParseResultIndex<Result>::BasicParseResultIndex(const Result &root_result)
+    : m_root(&root_result) {
+    // count first so the table is only sized once
+    std::size_t count = 0;
+    std::vector<const Result *> stack = {&root_result};
+    while (!stack.empty()) {
+        const Result *result = stack.back();
+        stack.pop_back();
+        count += result->m_children.size();
+        for (const Result &child : result->m_children) {
+            stack.push_back(&child);
+        }
+    }
+    m_children.reserve(count);
+    stack.push_back(&root_result);
+    while (!stack.empty()) {
+        const Result *result = stack.back();
+        stack.pop_back();
+        for (const Result &child : result->m_children) {
+            // emplace keeps the first child matched to a component
+            m_children.emplace(Key(result, child.m_component), &child);
+            stack.push_back(&child);
+        }
+    }
+}
+
+template <class Result>
+const Result *
+BasicParseResultIndex<Result>::find(const Result &parent,
+                                    const Component &component) const {
+    auto it = m_children.find(Key(&parent, &component));
+    return it != m_children.end() ? it->second : nullptr;
+}
+
+template <class Result>
+const Result *BasicParseResultIndex<Result>::find(const ResultPath &path) const {
+    std::span<const Component *const> components = path.getComponents();
+    if (components.empty() || m_root->m_component != components.front()) {
+        return nullptr;
+    }
+    const Result *result = m_root;
+    for (const Component *component : components.subspan(1)) {
+        result = find(*result, *component);
+        if (result == nullptr) {
+            return nullptr;
+        }
+    }
+    return result;
+}
+
+template <class Result>
+bool BasicParseResultIndex<Result>::contains(const ResultPath &path) const {
+    return find(path) != nullptr;
+}
+
+template class BasicParseResultIndex<ParseResult>;
+template class BasicParseResultIndex<ParseResultView>;
+
+template <class Result>
+BasicCompiledParseContext<Result>::BasicCompiledParseContext(
+    const CompiledGrammar &grammar, std::pmr::memory_resource *resource)
+    : m_grammar(&grammar), m_stack(resource), m_required_overflow(resource) {
+    // the stack can never be deeper than the grammar, so it never reallocates
+    m_stack.reserve(grammar.getMaxDepth());
+}
+
+// Words of m_required_overflow used by a node with required_count required
+// children.
+std::uint32_t getRequiredOverflowSize(std::uint32_t required_count) {
+    constexpr std::uint32_t mask_size = CompiledGrammar::required_mask_size;
+    if (required_count <= mask_size) {
+        return 0;
+    }
+    return (required_count - mask_size + mask_size - 1) / mask_size;
+}
+
+template <class Result>
+bool BasicCompiledParseContext<Result>::frameIsComplete(
+    const Frame &frame) const {
+    const CompiledGrammar::Node &node = m_grammar->getNode(frame.m_node);
+    auto required_count =
+        static_cast<std::uint32_t>(std::popcount(frame.m_required_mask));
+    const std::uint32_t overflow_size =
+        getRequiredOverflowSize(node.m_required_count);
+    for (std::uint32_t i = 0; i < overflow_size; ++i) {
+        required_count += static_cast<std::uint32_t>(
+            std::popcount(m_required_overflow[frame.m_overflow_begin + i]));
+    }
+    return required_count == node.m_required_count;
+}
+
+template <class Result>
+void BasicCompiledParseContext<Result>::pushFrame(
+    Handle result, CompiledGrammar::NodeIndex node) {
+    const auto overflow_begin =
+        static_cast<std::uint32_t>(m_required_overflow.size());
+    m_required_overflow.resize(
+        overflow_begin +
+            getRequiredOverflowSize(m_grammar->getNode(node).m_required_count),
+        0);
+    m_stack.push_back(Frame{result, node, 0, 0, overflow_begin});
+}
+
+template <class Result> void BasicCompiledParseContext<Result>::popFrame() {
+    m_required_overflow.resize(m_stack.back().m_overflow_begin);
+    m_stack.pop_back();
+}
+
+template <class Result>
+auto BasicCompiledParseContext<Result>::emplaceRoot(
+    CompiledGrammar::NodeIndex node, std::string_view token,
+    TypedValue typed_value) -> Handle {
+    const Component *component = m_grammar->getNode(node).m_component;
+    if constexpr (std::is_same_v<Result, FlatParseResult>) {
+        m_root_parse_result.emplace(m_stack.get_allocator().resource());
+        m_root_parse_result->reserve(m_reserve_node_count, m_reserve_text_size);
+        return m_root_parse_result->addNode(FlatParseResult::npos, component,
+                                            token, node, typed_value);
+    } else {
+        // std::string for ParseResult, std::string_view for ParseResultView
+        using Value = decltype(Result::m_value);
+        m_root_parse_result = Result{Value(token), component, {}, typed_value};
+        return &m_root_parse_result.value();
+    }
+}
+
+template <class Result>
+auto BasicCompiledParseContext<Result>::emplaceChild(
+    Handle parent, CompiledGrammar::NodeIndex node, std::string_view token,
+    TypedValue typed_value) -> Handle {
+    const Component *component = m_grammar->getNode(node).m_component;
+    if constexpr (std::is_same_v<Result, FlatParseResult>) {
+        return m_root_parse_result->addNode(parent, component, token, node,
+                                            typed_value);
+    } else {
+        using Value = decltype(Result::m_value);
+        parent->m_children.push_back(
+            Result{Value(token), component, {}, typed_value});
+        return &parent->m_children.back();
+    }
+}
+
+template <class Result>
+bool BasicCompiledParseContext<Result>::parseToken(std::string_view token) {
+    using NodeIndex = CompiledGrammar::NodeIndex;
+
+    // if first token
+    if (!m_root_parse_result.has_value()) {
+        // try to find a matching root component
+        auto root = m_grammar->findRoot(token);
+        if (!root.has_value()) {
+            return false;
+        }
+        Handle handle = emplaceRoot(
+            *root, token, *m_grammar->convertParameter(*root, token));
+        pushFrame(handle, *root);
+        return true;
+    }
+
+    // Same presidence as ParseContext::parseToken:
+    // 1. Flags
+    // 2. Commands
+    // 3. Parameters
+    // With NameMatching::UniquePrefix, prefixes of flags and then commands are
+    // tried after exact matches but before parameters.
+    using NameMatching = CompiledGrammar::NameMatching;
+    while (!m_stack.empty()) {
+        Frame &frame = m_stack.back();
+        const CompiledGrammar::Node &node = m_grammar->getNode(frame.m_node);
+
+        if (node.m_children_begin == node.m_children_end) {
+            // if component has no children, then there is nothing to parse
+            return false;
+        }
+
+        std::optional<NodeIndex> match =
+            m_grammar->findFlag(frame.m_node, token, NameMatching::Exact);
+
+        if (!match.has_value()) {
+            match =
+                m_grammar->findCommand(frame.m_node, token, NameMatching::Exact);
+        }
+
+        if (!match.has_value() &&
+            m_grammar->getNameMatching() == NameMatching::UniquePrefix) {
+            match = m_grammar->findFlag(frame.m_node, token,
+                                        NameMatching::UniquePrefix);
+            if (!match.has_value()) {
+                match = m_grammar->findCommand(frame.m_node, token,
+                                               NameMatching::UniquePrefix);
+            }
+        }
+
+        // a typed parameter that rejects token is not a match
+        std::optional<TypedValue> typed_value = TypedValue();
+        if (!match.has_value()) {
+            const auto parameters = m_grammar->getParameters(frame.m_node);
+            if (frame.m_parameter_count < parameters.size()) {
+                NodeIndex parameter = parameters[frame.m_parameter_count];
+                typed_value = m_grammar->convertParameter(parameter, token);
+                if (typed_value.has_value()) {
+                    match = parameter;
+                    ++frame.m_parameter_count;
+                }
+            }
+        }
+
+        if (match.has_value()) {
+            const CompiledGrammar::Node &child = m_grammar->getNode(*match);
+            constexpr std::uint32_t mask_size =
+                CompiledGrammar::required_mask_size;
+            if (child.m_required_index < mask_size) {
+                frame.m_required_mask |= std::uint64_t(1)
+                                         << child.m_required_index;
+            } else if (child.m_required_index != CompiledGrammar::npos) {
+                const std::uint32_t index = child.m_required_index - mask_size;
+                m_required_overflow[frame.m_overflow_begin + index / mask_size] |=
+                    std::uint64_t(1) << (index % mask_size);
+            }
+            Handle handle =
+                emplaceChild(frame.m_result, *match, token, *typed_value);
+            // if child has children, then push it onto the stack
+            if (child.m_children_begin != child.m_children_end) {
+                pushFrame(handle, *match);
+            }
+            return true;
+        }
+
+        if (!frameIsComplete(frame)) {
+            // if we have not found all required child components, then we
+            // cannot pop as the current parse result is not complete
+            return false;
+        }
+
+        popFrame();
+    }
+    return false;
+}
+
+template <class Result>
+bool BasicCompiledParseContext<Result>::getNextSuggestions(
+    std::string_view token, const SuggestionSink &sink) const {
+    using NodeIndex = CompiledGrammar::NodeIndex;
+
+    NodeIndex parent = CompiledGrammar::npos;
+    bool parameters_consumed = false;
+    if (!m_stack.empty()) {
+        const Frame &frame = m_stack.back();
+        parent = frame.m_node;
+        parameters_consumed = frame.m_parameter_count >=
+                              m_grammar->getParameters(frame.m_node).size();
+    } else if (m_root_parse_result.has_value()) {
+        return true;
+    }
+    // if we have no parse result, then suggest next token based on root
+    // components
+
+    // The names matching token come from the sorted name index, and are put
+    // back in declaration order so the result is the same as asking every
+    // child in turn. Children with their own SuggestionsFunc are merged in.
+    // Only the first few matches are sorted up front, the rest only if the
+    // sink asks for more, so a sink that stops early does not pay for sorting
+    // every match.
+    constexpr std::size_t first_sorted_count = 32;
+    auto names = m_grammar->findNamesWithPrefix(parent, token);
+    std::vector<NodeIndex> matches(names.begin(), names.end());
+    auto sorted_end =
+        matches.begin() + std::min(first_sorted_count, matches.size());
+    std::partial_sort(matches.begin(), sorted_end, matches.end());
+    auto custom = m_grammar->getCustomSuggestions(parent);
+
+    auto match = matches.begin();
+    auto custom_child = custom.begin();
+    while (match != matches.end() || custom_child != custom.end()) {
+        if (match == sorted_end) {
+            std::sort(sorted_end, matches.end());
+            sorted_end = matches.end();
+        }
+        if (custom_child == custom.end() ||
+            (match != matches.end() && *match < *custom_child)) {
+            if (!sink(m_grammar->getName(*match))) {
+                return false;
+            }
+            ++match;
+            continue;
+        }
+        const CompiledGrammar::Node &child = m_grammar->getNode(*custom_child);
+        ++custom_child;
+        // if we have found all parameters, don't suggest any more parameters
+        if (parameters_consumed && child.m_type == ComponentType::Parameter) {
+            continue;
+        }
+        if (!child.m_component->getSuggestions(token, sink)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class Result>
+std::vector<std::string>
+BasicCompiledParseContext<Result>::getCorrections(std::string_view token,
+                                                  std::size_t max_distance) const {
+    // same node as getNextSuggestions
+    CompiledGrammar::NodeIndex parent = CompiledGrammar::npos;
+    if (!m_stack.empty()) {
+        parent = m_stack.back().m_node;
+    } else if (m_root_parse_result.has_value()) {
+        return {};
+    }
+
+    std::vector<std::string> corrections;
+    for (const auto &similar_name :
+         m_grammar->findSimilarNames(parent, token, max_distance)) {
+        corrections.emplace_back(similar_name.m_name);
+    }
+    return corrections;
+}
+
+template <class Result>
+std::vector<std::string> BasicCompiledParseContext<Result>::getNextSuggestions(
+    std::string_view token) const {
+    std::vector<std::string> suggestions;
+    getNextSuggestions(token, [&](std::string_view suggestion) {
+        suggestions.emplace_back(suggestion);
+        return true;
+    });
+    return suggestions;
+}
+
+template <class Result>
+std::pmr::vector<std::pmr::string>
+BasicCompiledParseContext<Result>::getNextSuggestions(
+    std::string_view token, std::pmr::memory_resource *resource) const {
+    std::pmr::vector<std::pmr::string> suggestions(resource);
+    getNextSuggestions(token, [&](std::string_view suggestion) {
+        suggestions.emplace_back(suggestion);
+        return true;
+    });
+    return suggestions;
+}
+
+template <class Result>
+void BasicCompiledParseContext<Result>::reserve(std::size_t node_count,
+                                                std::size_t text_size)
+    requires std::is_same_v<Result, FlatParseResult>
+{
+    m_reserve_node_count = node_count;
+    m_reserve_text_size = text_size;
+    if (m_root_parse_result.has_value()) {
+        m_root_parse_result->reserve(node_count, text_size);
+    }
+}
+
+template <class Result>
+const std::optional<Result> &
+BasicCompiledParseContext<Result>::getRootParseResult() const {
+    return m_root_parse_result;
+}
+
+template <class Result>
+std::optional<Result> BasicCompiledParseContext<Result>::takeRootParseResult() {
+    m_stack.clear();
+    m_required_overflow.clear();
+    return std::exchange(m_root_parse_result, std::nullopt);
+}
+
+template <class Result>
+bool BasicCompiledParseContext<Result>::isComplete() const {
+    if (!m_root_parse_result.has_value()) {
+        return false;
+    }
+    if (m_stack.empty()) {
+        return true;
+    }
+    return frameIsComplete(m_stack.back());
+}
+
+template <class Result>
+auto BasicCompiledParseContext<Result>::checkpoint() const -> Checkpoint
+    requires(!std::is_same_v<Result, FlatParseResult>)
+{
+    Checkpoint checkpoint;
+    checkpoint.m_has_root = m_root_parse_result.has_value();
+    checkpoint.m_stack.assign(m_stack.begin(), m_stack.end());
+    checkpoint.m_required_overflow.assign(m_required_overflow.begin(),
+                                          m_required_overflow.end());
+    for (const Frame &frame : m_stack) {
+        checkpoint.m_child_counts.push_back(frame.m_result->m_children.size());
+    }
+    return checkpoint;
+}
+
+template <class Result>
+void BasicCompiledParseContext<Result>::rollback(const Checkpoint &checkpoint)
+    requires(!std::is_same_v<Result, FlatParseResult>)
+{
+    m_stack.assign(checkpoint.m_stack.begin(), checkpoint.m_stack.end());
+    m_required_overflow.assign(checkpoint.m_required_overflow.begin(),
+                               checkpoint.m_required_overflow.end());
+    if (!checkpoint.m_has_root) {
+        m_root_parse_result.reset();
+        return;
+    }
+    assert(m_root_parse_result.has_value());
+    // same as ParseContext::rollback, the results may have moved since the
+    // checkpoint, so the frames are pointed at them again
+    Result *parse_result = &m_root_parse_result.value();
+    for (std::size_t depth = 0; depth < m_stack.size(); ++depth) {
+        auto &children = parse_result->m_children;
+        children.erase(children.begin() + checkpoint.m_child_counts[depth],
+                       children.end());
+        m_stack[depth].m_result = parse_result;
+        if (!children.empty()) {
+            parse_result = &children.back();
+        }
+    }
+}
+
+template class BasicCompiledParseContext<ParseResult>;
+template class BasicCompiledParseContext<ParseResultView>;
+template class BasicCompiledParseContext<FlatParseResult>;
+
+template <class Tokens>
+void tokenizeScalarInto(Tokens &tokens, std::string_view input_string) {
+    size_t startPos = 0;
+    size_t endPos = 0;
+    bool insideQuotes = false;
+    bool escaped = false;
+
+    while (endPos < input_string.length()) {
+        if (input_string[endPos] == '"' && !escaped) {
+            insideQuotes = !insideQuotes;
+        }
+
+        if (input_string[endPos] == '\\' && !escaped) {
+            escaped = true;
+        } else {
+            escaped = false;
+        }
+
+        if (!insideQuotes && input_string[endPos] == ' ' && !escaped) {
+            if (endPos > startPos) {
+                tokens.push_back(
+                    input_string.substr(startPos, endPos - startPos));
+            }
+            startPos = endPos + 1;
+        }
+
+        ++endPos;
+    }
+
+    // Handle the last word if it's not followed by a space
+    if (endPos > startPos) {
+        tokens.push_back(input_string.substr(startPos, endPos - startPos));
+    }
+
+    // Remove quotes from tokens, if any
+    for (auto &token : tokens) {
+        if (token.length() >= 2 && token.front() == '"' &&
+            token.back() == '"') {
+            token = token.substr(1, token.length() - 2);
+        }
+    }
+}
+
+// Bitmask tokenizer.
+// The input is scanned in blocks of 64 bytes, for each block a kernel builds
+// one bit per byte for quotes, backslashes and spaces. Escapes and quote state
+// are then resolved with bit arithmetic on the masks, carrying state from one
+// block to the next, and every space outside quotes is a delimiter.
+
+struct TokenizerBlockMasks {
+    std::uint64_t m_quote;
+    std::uint64_t m_backslash;
+    std::uint64_t m_space;
+};
+
+constexpr std::size_t tokenizer_block_size = 64;
+
+TokenizerBlockMasks scanTokenizerBlockScalar(const char *block) {
+    TokenizerBlockMasks masks{0, 0, 0};
+    for (std::size_t i = 0; i < tokenizer_block_size; ++i) {
+        std::uint64_t bit = std::uint64_t(1) << i;
+        masks.m_quote |= block[i] == '"' ? bit : 0;
+        masks.m_backslash |= block[i] == '\\' ? bit : 0;
+        masks.m_space |= block[i] == ' ' ? bit : 0;
+    }
+    return masks;
+}
+
+#ifdef OPTIONPARSER_V2_X86_SIMD
+__attribute__((target("sse4.2"))) TokenizerBlockMasks
+scanTokenizerBlockSse42(const char *block) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i space = _mm_set1_epi8(' ');
+    TokenizerBlockMasks masks{0, 0, 0};
+    for (std::size_t i = 0; i < tokenizer_block_size; i += 16) {
+        __m128i chunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(block + i));
+        masks.m_quote |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(
+                             _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote))))
+                         << i;
+        masks.m_backslash |=
+            static_cast<std::uint64_t>(static_cast<std::uint16_t>(
+                _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash))))
+            << i;
+        masks.m_space |= static_cast<std::uint64_t>(static_cast<std::uint16_t>(
+                             _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, space))))
+                         << i;
+    }
+    return masks;
+}
+
+__attribute__((target("avx2"))) TokenizerBlockMasks
+scanTokenizerBlockAvx2(const char *block) {
+    const __m256i quote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+    const __m256i space = _mm256_set1_epi8(' ');
+    TokenizerBlockMasks masks{0, 0, 0};
+    for (std::size_t i = 0; i < tokenizer_block_size; i += 32) {
+        __m256i chunk =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + i));
+        // lambdas do not inherit the target attribute, so no helper here
+        masks.m_quote |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(
+                             _mm256_movemask_epi8(
+                                 _mm256_cmpeq_epi8(chunk, quote))))
+                         << i;
+        masks.m_backslash |=
+            static_cast<std::uint64_t>(static_cast<std::uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, backslash))))
+            << i;
+        masks.m_space |= static_cast<std::uint64_t>(static_cast<std::uint32_t>(
+                             _mm256_movemask_epi8(
+                                 _mm256_cmpeq_epi8(chunk, space))))
+                         << i;
+    }
+    return masks;
+}
+#endif
+
+/// @brief Get the mask of characters escaped by a backslash.
+/// A backslash escapes the next character unless it is escaped itself, so
+/// only the odd backslashes of a run escape anything.
+/// @param backslash Backslash mask of the block
+/// @param prev_escaped 1 if the first character of the block is escaped,
+/// updated for the next block.
+/// @return
+std::uint64_t findEscaped(std::uint64_t backslash,
+                          std::uint64_t &prev_escaped) {
+    // an escaped backslash does not escape anything
+    backslash &= ~prev_escaped;
+    std::uint64_t follows_escape = backslash << 1 | prev_escaped;
+
+    // runs of backslashes starting on an odd bit are found by adding their
+    // start to the backslash mask, the carry clears the run
+    const std::uint64_t even_bits = 0x5555555555555555ULL;
+    std::uint64_t odd_sequence_starts =
+        backslash & ~even_bits & ~follows_escape;
+    std::uint64_t sequences_starting_on_even_bits;
+    prev_escaped = __builtin_add_overflow(odd_sequence_starts, backslash,
+                                          &sequences_starting_on_even_bits);
+    std::uint64_t invert_mask = sequences_starting_on_even_bits << 1;
+
+    return (even_bits ^ invert_mask) & follows_escape;
+}
+
+/// @brief Each bit becomes the xor of itself and all lower bits.
+std::uint64_t prefixXor(std::uint64_t bits) {
+    bits ^= bits << 1;
+    bits ^= bits << 2;
+    bits ^= bits << 4;
+    bits ^= bits << 8;
+    bits ^= bits << 16;
+    bits ^= bits << 32;
+    return bits;
+}
+
+template <class Tokens>
+void tokenizeBlocksInto(Tokens &tokens, std::string_view input_string,
+                        TokenizerBlockMasks (*scan_block)(const char *)) {
+    auto push_token = [&](std::size_t begin, std::size_t end) {
+        if (end <= begin) {
+            return;
+        }
+        std::string_view token = input_string.substr(begin, end - begin);
+        // Remove quotes from token, if any
+        if (token.length() >= 2 && token.front() == '"' &&
+            token.back() == '"') {
+            token = token.substr(1, token.length() - 2);
+        }
+        tokens.push_back(token);
+    };
+
+    std::uint64_t prev_escaped = 0;
+    std::uint64_t prev_inside_quotes = 0;
+    std::size_t start = 0;
+    for (std::size_t offset = 0; offset < input_string.size();
+         offset += tokenizer_block_size) {
+        TokenizerBlockMasks masks;
+        std::size_t remaining = input_string.size() - offset;
+        if (remaining >= tokenizer_block_size) {
+            masks = scan_block(input_string.data() + offset);
+        } else {
+            // zero padding never matches any of the characters
+            char block[tokenizer_block_size] = {};
+            std::memcpy(block, input_string.data() + offset, remaining);
+            masks = scan_block(block);
+        }
+
+        std::uint64_t escaped = findEscaped(masks.m_backslash, prev_escaped);
+        std::uint64_t quotes = masks.m_quote & ~escaped;
+        std::uint64_t inside_quotes = prefixXor(quotes) ^ prev_inside_quotes;
+        prev_inside_quotes =
+            static_cast<std::uint64_t>(static_cast<std::int64_t>(inside_quotes) >>
+                                       63);
+
+        std::uint64_t delimiters = masks.m_space & ~inside_quotes;
+        while (delimiters != 0) {
+            std::size_t pos = offset + std::countr_zero(delimiters);
+            push_token(start, pos);
+            start = pos + 1;
+            delimiters &= delimiters - 1;
+        }
+    }
+    push_token(start, input_string.size());
+}
+
+bool isTokenizerBackendSupported(TokenizerBackend backend) {
+    switch (backend) {
+    case TokenizerBackend::Scalar:
+        return true;
+#ifdef OPTIONPARSER_V2_X86_SIMD
+    case TokenizerBackend::Sse42:
+        return __builtin_cpu_supports("sse4.2");
+    case TokenizerBackend::Avx2:
+        return __builtin_cpu_supports("avx2");
+#else
+    case TokenizerBackend::Sse42:
+    case TokenizerBackend::Avx2:
+        return false;
+#endif
+    }
+    return false;
+}
+
+TokenizerBackend getTokenizerBackend() {
+    static const TokenizerBackend backend = [] {
+        for (auto backend : {TokenizerBackend::Avx2, TokenizerBackend::Sse42}) {
+            if (isTokenizerBackendSupported(backend)) {
+                return backend;
+            }
+        }
+        return TokenizerBackend::Scalar;
+    }();
+    return backend;
+}
+
+template <class Tokens>
+void tokenizeInto(Tokens &tokens, std::string_view input_string,
+                  TokenizerBackend backend) {
+    assert(isTokenizerBackendSupported(backend));
+    switch (backend) {
+    case TokenizerBackend::Scalar:
+        tokenizeScalarInto(tokens, input_string);
+        return;
+#ifdef OPTIONPARSER_V2_X86_SIMD
+    case TokenizerBackend::Sse42:
+        tokenizeBlocksInto(tokens, input_string, scanTokenizerBlockSse42);
+        return;
+    case TokenizerBackend::Avx2:
+        tokenizeBlocksInto(tokens, input_string, scanTokenizerBlockAvx2);
+        return;
+#else
+    case TokenizerBackend::Sse42:
+    case TokenizerBackend::Avx2:
+        break;
+#endif
+    }
+    tokenizeBlocksInto(tokens, input_string, scanTokenizerBlockScalar);
+}
+
+template <class Tokens>
+void tokenizeInto(Tokens &tokens, std::string_view input_string) {
+    // the byte loop is cheaper for inputs shorter than one block
+    if (input_string.size() < tokenizer_block_size) {
+        tokenizeScalarInto(tokens, input_string);
+        return;
+    }
+    tokenizeInto(tokens, input_string, getTokenizerBackend());
+}
+
+std::vector<std::string_view> tokenize(std::string_view input_string) {
+    std::vector<std::string_view> tokens;
+    tokenizeInto(tokens, input_string);
+    return tokens;
+}
+
+std::vector<std::string_view> tokenize(std::string_view input_string,
+                                       TokenizerBackend backend) {
+    std::vector<std::string_view> tokens;
+    tokenizeInto(tokens, input_string, backend);
+    return tokens;
+}
+
+std::pmr::vector<std::string_view>
+tokenize(std::string_view input_string, std::pmr::memory_resource *resource) {
+    std::pmr::vector<std::string_view> tokens(resource);
+    tokenizeInto(tokens, input_string);
+    return tokens;
+}
+
+template <class Context>
+StreamParser<Context>::StreamParser(Context &context) : m_context(&context) {}
+
+template <class Context>
+bool StreamParser<Context>::feed(std::string_view chunk) {
+    if (m_failed) {
+        return false;
+    }
+
+    // same state machine as tokenize, with the state kept between chunks
+    std::size_t start = 0;
+    for (std::size_t pos = 0; pos < chunk.size(); ++pos) {
+        if (chunk[pos] == '"' && !m_escaped) {
+            m_inside_quotes = !m_inside_quotes;
+        }
+
+        if (chunk[pos] == '\\' && !m_escaped) {
+            m_escaped = true;
+        } else {
+            m_escaped = false;
+        }
+
+        if (!m_inside_quotes && chunk[pos] == ' ' && !m_escaped) {
+            if (!m_partial_token.empty()) {
+                // token started in an earlier chunk
+                m_partial_token.append(chunk.substr(start, pos - start));
+                bool parsed = parseToken(m_partial_token);
+                m_partial_token.clear();
+                if (!parsed) {
+                    return false;
+                }
+            } else if (pos > start) {
+                if (!parseToken(chunk.substr(start, pos - start))) {
+                    return false;
+                }
+            }
+            start = pos + 1;
+        }
+    }
+
+    m_partial_token.append(chunk.substr(start));
+    return true;
+}
+
+template <class Context> bool StreamParser<Context>::finish() {
+    if (m_failed) {
+        return false;
+    }
+    if (m_partial_token.empty()) {
+        return true;
+    }
+    bool parsed = parseToken(m_partial_token);
+    m_partial_token.clear();
+    return parsed;
+}
+
+template <class Context> bool StreamParser<Context>::failed() const {
+    return m_failed;
+}
+
+template <class Context> Context &StreamParser<Context>::getContext() {
+    return *m_context;
+}
+
+template <class Context>
+const Context &StreamParser<Context>::getContext() const {
+    return *m_context;
+}
+
+template <class Context>
+bool StreamParser<Context>::parseToken(std::string_view token) {
+    // Remove quotes from token, if any
+    if (token.length() >= 2 && token.front() == '"' && token.back() == '"') {
+        token = token.substr(1, token.length() - 2);
+    }
+    m_failed = !m_context->parseToken(token);
+    return !m_failed;
+}
+
+template class StreamParser<ParseContext>;
+template class StreamParser<CompiledParseContext>;
+template class StreamParser<CompiledFlatParseContext>;
+
+template <class Context>
+CompletionSession<Context>::CompletionSession(Context &context)
+    : m_context(&context) {}
+
+template <class Context>
+void CompletionSession<Context>::append(std::string_view text) {
+    std::size_t unchanged_size = m_line.size();
+    m_line.append(text);
+    update(unchanged_size);
+}
+
+template <class Context>
+void CompletionSession<Context>::erase(std::size_t count) {
+    m_line.resize(m_line.size() - std::min(count, m_line.size()));
+    update(m_line.size());
+}
+
+template <class Context>
+void CompletionSession<Context>::setLine(std::string_view line) {
+    std::size_t unchanged_size =
+        std::mismatch(m_line.begin(),
+                      m_line.begin() + std::min(m_line.size(), line.size()),
+                      line.begin())
+            .first -
+        m_line.begin();
+    m_line.assign(line);
+    update(unchanged_size);
+}
+
+template <class Context>
+std::vector<std::string> CompletionSession<Context>::getNextSuggestions() const {
+    // same choice of token as nextTokenSuggestions
+    std::size_t parsed_count = m_checkpoints.size();
+    if (m_failed) {
+        return m_context->getNextSuggestions(getToken(parsed_count - 1));
+    }
+    if (parsed_count < m_tokens.size()) {
+        return m_context->getNextSuggestions(getToken(parsed_count));
+    }
+    return m_context->getNextSuggestions("");
+}
+
+template <class Context>
+bool CompletionSession<Context>::getNextSuggestions(
+    const SuggestionSink &sink) const {
+    std::size_t parsed_count = m_checkpoints.size();
+    if (m_failed) {
+        return m_context->getNextSuggestions(getToken(parsed_count - 1), sink);
+    }
+    if (parsed_count < m_tokens.size()) {
+        return m_context->getNextSuggestions(getToken(parsed_count), sink);
+    }
+    return m_context->getNextSuggestions("", sink);
+}
+
+template <class Context>
+const std::string &CompletionSession<Context>::getLine() const {
+    return m_line;
+}
+
+template <class Context>
+const Context &CompletionSession<Context>::getContext() const {
+    return *m_context;
+}
+
+template <class Context>
+void CompletionSession<Context>::update(std::size_t unchanged_size) {
+    // a token is unchanged if the delimiter after it is
+    std::size_t kept_count =
+        std::partition_point(m_tokens.begin(), m_tokens.end(),
+                             [&](const Token &token) {
+                                 return token.m_end < unchanged_size;
+                             }) -
+        m_tokens.begin();
+    m_tokens.resize(kept_count);
+
+    // the tokenizer state is reset after a delimiter, so the rest of the line
+    // is tokenized on its own, with the same state machine as tokenize
+    std::size_t start = kept_count == 0 ? 0 : m_tokens.back().m_end + 1;
+    bool inside_quotes = false;
+    bool escaped = false;
+    for (std::size_t pos = start; pos < m_line.size(); ++pos) {
+        if (m_line[pos] == '"' && !escaped) {
+            inside_quotes = !inside_quotes;
+        }
+
+        if (m_line[pos] == '\\' && !escaped) {
+            escaped = true;
+        } else {
+            escaped = false;
+        }
+
+        if (!inside_quotes && m_line[pos] == ' ' && !escaped) {
+            if (pos > start) {
+                m_tokens.push_back(Token{start, pos});
+            }
+            start = pos + 1;
+        }
+    }
+    if (m_line.size() > start) {
+        m_tokens.push_back(Token{start, m_line.size()});
+    }
+
+    // like nextTokenSuggestions, a last token that ends the line is still
+    // being typed and is not parsed
+    std::size_t parse_count = m_tokens.size();
+    if (parse_count > 0 && m_line.ends_with(getToken(parse_count - 1))) {
+        --parse_count;
+    }
+
+    std::size_t rollback_count = std::min(kept_count, parse_count);
+    if (rollback_count < m_checkpoints.size()) {
+        m_context->rollback(m_checkpoints[rollback_count]);
+        m_checkpoints.resize(rollback_count);
+        m_failed = false;
+    }
+
+    while (!m_failed && m_checkpoints.size() < parse_count) {
+        m_checkpoints.push_back(m_context->checkpoint());
+        m_failed = !m_context->parseToken(getToken(m_checkpoints.size() - 1));
+    }
+}
+
+template <class Context>
+std::string_view CompletionSession<Context>::getToken(std::size_t index) const {
+    std::string_view token = std::string_view(m_line).substr(
+        m_tokens[index].m_begin, m_tokens[index].m_end - m_tokens[index].m_begin);
+    // Remove quotes from token, if any
+    if (token.length() >= 2 && token.front() == '"' && token.back() == '"') {
+        token = token.substr(1, token.length() - 2);
+    }
+    return token;
+}
+
+template class CompletionSession<ParseContext>;
+template class CompletionSession<CompiledParseContext>;
+
+template <class Context, class Tokens>
+auto parseTokensWithContext(Context &parse_context, const Tokens &tokens)
+    -> decltype(parse_context.takeRootParseResult()) {
+    for (const auto &token : tokens) {
+        if (!parse_context.parseToken(token)) {
+            return std::nullopt;
+        }
+    }
+    // move the result tree out instead of copying it
+    return parse_context.takeRootParseResult();
+}
+
+template <class Context>
+auto parseWithContext(Context &parse_context, std::string_view input_string)
+    -> decltype(parse_context.takeRootParseResult()) {
+    // tokenize input_string
+    return parseTokensWithContext(parse_context, tokenize(input_string));
+}
+
+std::optional<ParseResult> parseMultiImpl(
+    const std::vector<std::reference_wrapper<const Component>> &root_components,
+    std::string_view input_string) {
+    ParseContext parse_context(root_components);
+    return parseWithContext(parse_context, input_string);
+}
+
+std::optional<ParseResult> parseMultiRef(
+    const std::vector<std::reference_wrapper<const Component>> &root_components,
+    std::string_view input_string) {
+    return parseMultiImpl(root_components, input_string);
+}
+
+std::optional<ParseResult>
+parseMulti(const std::vector<Component> &root_components,
+           std::string_view input_string) {
+    std::vector<std::reference_wrapper<const Component>> root_component_refs;
+    for (const auto &root_component : root_components) {
+        root_component_refs.push_back(std::ref(root_component));
+    }
+    return parseMultiRef(root_component_refs, input_string);
+}
+
+std::optional<ParseResult> parse(const Component &root_component,
+                                 std::string_view input_string) {
+    return parseMultiImpl({std::ref(root_component)}, input_string);
+}
+
+std::optional<ParseResult> parse(const CompiledGrammar &grammar,
+                                 std::string_view input_string) {
+    CompiledParseContext parse_context(grammar);
+    return parseWithContext(parse_context, input_string);
+}
+
+std::optional<ParseResultView> parseView(const CompiledGrammar &grammar,
+                                         std::string_view input_string) {
+    CompiledParseViewContext parse_context(grammar);
+    return parseWithContext(parse_context, input_string);
+}
+
+std::optional<FlatParseResult> parseFlat(const CompiledGrammar &grammar,
+                                         std::string_view input_string) {
+    std::vector<std::string_view> tokens = tokenize(input_string);
+
+    CompiledFlatParseContext parse_context(grammar);
+    // one node per token, and never more text than the input
+    parse_context.reserve(tokens.size(), input_string.size());
+    return parseTokensWithContext(parse_context, tokens);
+}
+
+std::optional<FlatParseResult> parseFlat(const CompiledGrammar &grammar,
+                                         std::string_view input_string,
+                                         std::pmr::memory_resource *resource) {
+    std::pmr::vector<std::string_view> tokens =
+        tokenize(input_string, resource);
+
+    CompiledFlatParseContext parse_context(grammar, resource);
+    parse_context.reserve(tokens.size(), input_string.size());
+    return parseTokensWithContext(parse_context, tokens);
+}
+
+template <class ParseLine>
+auto parseBatchImpl(std::span<const std::string_view> input_strings,
+                    std::size_t thread_count, ParseLine parse_line) {
+    using Result = decltype(parse_line(std::string_view()));
+    // lines are claimed in chunks, to keep the atomics off the hot path
+    constexpr std::size_t grain_size = 64;
+
+    std::vector<Result> results(input_strings.size());
+    if (thread_count == 0) {
+        thread_count = std::thread::hardware_concurrency();
+    }
+    std::size_t chunk_count = (input_strings.size() + grain_size - 1) / grain_size;
+    thread_count = std::clamp<std::size_t>(thread_count, 1,
+                                           std::max<std::size_t>(chunk_count, 1));
+
+    struct WorkRange {
+        std::atomic<std::size_t> m_next;
+        std::size_t m_end;
+    };
+    std::vector<WorkRange> ranges(thread_count);
+    for (std::size_t id = 0; id < thread_count; ++id) {
+        ranges[id].m_next = input_strings.size() * id / thread_count;
+        ranges[id].m_end = input_strings.size() * (id + 1) / thread_count;
+    }
+
+    auto run_range = [&](WorkRange &range) {
+        for (;;) {
+            std::size_t begin = range.m_next.fetch_add(grain_size);
+            if (begin >= range.m_end) {
+                return;
+            }
+            std::size_t end = std::min(begin + grain_size, range.m_end);
+            for (std::size_t i = begin; i < end; ++i) {
+                results[i] = parse_line(input_strings[i]);
+            }
+        }
+    };
+    auto worker = [&](std::size_t id) {
+        // own range first, then steal from the others
+        for (std::size_t offset = 0; offset < thread_count; ++offset) {
+            run_range(ranges[(id + offset) % thread_count]);
+        }
+    };
+
+    {
+        std::vector<std::jthread> threads;
+        for (std::size_t id = 1; id < thread_count; ++id) {
+            threads.emplace_back(worker, id);
+        }
+        worker(0);
+    }
+    return results;
+}
+
+std::vector<std::optional<ParseResult>>
+parseBatch(const Component &root_component,
+           std::span<const std::string_view> input_strings,
+           std::size_t thread_count) {
+    return parseBatchImpl(input_strings, thread_count,
+                          [&](std::string_view input_string) {
+                              return parse(root_component, input_string);
+                          });
+}
+
+std::vector<std::optional<ParseResult>>
+parseBatchMulti(const std::vector<Component> &root_components,
+                std::span<const std::string_view> input_strings,
+                std::size_t thread_count) {
+    std::vector<std::reference_wrapper<const Component>> root_component_refs(
+        root_components.begin(), root_components.end());
+    return parseBatchImpl(input_strings, thread_count,
+                          [&](std::string_view input_string) {
+                              return parseMultiImpl(root_component_refs,
+                                                    input_string);
+                          });
+}
+
+std::vector<std::optional<ParseResult>>
+parseBatch(const CompiledGrammar &grammar,
+           std::span<const std::string_view> input_strings,
+           std::size_t thread_count) {
+    return parseBatchImpl(input_strings, thread_count,
+                          [&](std::string_view input_string) {
+                              return parse(grammar, input_string);
+                          });
+}
+
+const ParseResult &getLastParseResult(const ParseResult &parse_result) {
+    const ParseResult *last = &parse_result;
+    while (!last->m_children.empty()) {
+        last = &last->m_children.back();
+    }
+    return *last;
+}
+
+template <class Context, class Tokens>
+std::string_view parseUntilNextToken(Context &parse_context,
+                                     const std::string_view &input_string,
+                                     const Tokens &tokens) {
+    auto it = std::begin(tokens);
+    for (; it != std::end(tokens); ++it) {
+        // if the last token maches the end of the input_string, don't parse it
+
+        if (it == std::end(tokens) - 1 && input_string.ends_with(*it)) {
+            break;
+        }
+
+        if (!parse_context.parseToken(*it)) {
+            break;
+        }
+    }
+    if (it != std::end(tokens)) {
+        // if parse failed, suggest next token based on last token and
+        // root_component
+        return *it;
+    }
+    return "";
+}
+
+template <class Context, class Tokens, class... Args>
+auto nextTokenSuggestionsWithContext(Context &parse_context,
+                                     const std::string_view &input_string,
+                                     const Tokens &tokens,
+                                     const Args &...args)
+    -> decltype(parse_context.getNextSuggestions("", args...)) {
+    return parse_context.getNextSuggestions(
+        parseUntilNextToken(parse_context, input_string, tokens), args...);
+}
+
+std::vector<std::string> nextTokenSuggestionsMultiImpl(
+    const std::vector<std::reference_wrapper<const Component>> &root_components,
+    const std::string_view &input_string) {
+    ParseContext parse_context(root_components);
+    return nextTokenSuggestionsWithContext(parse_context, input_string,
+                                           tokenize(input_string));
+}
+
+std::vector<std::string> nextTokenSuggestionsMultiRef(
+    const std::vector<std::reference_wrapper<const Component>> &root_components,
+    const std::string_view &input_string) {
+    return nextTokenSuggestionsMultiImpl(root_components, input_string);
+}
+
+std::vector<std::string>
+nextTokenSuggestionsMulti(const std::vector<Component> &root_components,
+                          const std::string_view &input_string) {
+
+    std::vector<std::reference_wrapper<const Component>> root_component_refs;
+    for (const auto &root_component : root_components) {
+        root_component_refs.push_back(std::ref(root_component));
+    }
+    return nextTokenSuggestionsMultiRef(root_component_refs, input_string);
+}
+
+std::vector<std::string>
+nextTokenSuggestions(const Component &root_component,
+                     const std::string_view &input_string) {
+    return nextTokenSuggestionsMultiImpl({std::ref(root_component)},
+                                         input_string);
+}
+
+std::vector<std::string>
+nextTokenSuggestions(const CompiledGrammar &grammar,
+                     const std::string_view &input_string) {
+    CompiledParseContext parse_context(grammar);
+    return nextTokenSuggestionsWithContext(parse_context, input_string,
+                                           tokenize(input_string));
+}
+
+std::pmr::vector<std::pmr::string>
+nextTokenSuggestions(const CompiledGrammar &grammar,
+                     const std::string_view &input_string,
+                     std::pmr::memory_resource *resource) {
+    // the flat context is the only one whose results use the resource
+    CompiledFlatParseContext parse_context(grammar, resource);
+    return nextTokenSuggestionsWithContext(parse_context, input_string,
+                                           tokenize(input_string, resource),
+                                           resource);
+}
+
+template <class Context, class Tokens>
+std::size_t nextTokenSuggestionsToSink(Context &parse_context,
+                                       std::string_view input_string,
+                                       const Tokens &tokens,
+                                       const SuggestionSink &sink,
+                                       std::size_t max_count) {
+    struct Limit {
+        std::size_t m_count;
+        std::size_t m_max_count;
+    } limit{0, max_count};
+    if (limit.m_max_count == 0) {
+        return 0;
+    }
+    // two references, small enough to not allocate in std::function
+    nextTokenSuggestionsWithContext(
+        parse_context, input_string, tokens,
+        SuggestionSink([&limit, &sink](std::string_view suggestion) {
+            ++limit.m_count;
+            return sink(suggestion) && limit.m_count < limit.m_max_count;
+        }));
+    return limit.m_count;
+}
+
+std::size_t nextTokenSuggestions(const Component &root_component,
+                                 std::string_view input_string,
+                                 const SuggestionSink &sink,
+                                 std::size_t max_count) {
+    ParseContext parse_context(root_component);
+    return nextTokenSuggestionsToSink(parse_context, input_string,
+                                      tokenize(input_string), sink, max_count);
+}
+
+std::size_t
+nextTokenSuggestionsMulti(const std::vector<Component> &root_components,
+                          std::string_view input_string,
+                          const SuggestionSink &sink, std::size_t max_count) {
+    ParseContext parse_context(root_components);
+    return nextTokenSuggestionsToSink(parse_context, input_string,
+                                      tokenize(input_string), sink, max_count);
+}
+
+std::size_t nextTokenSuggestions(const CompiledGrammar &grammar,
+                                 std::string_view input_string,
+                                 const SuggestionSink &sink,
+                                 std::size_t max_count) {
+    // the result is thrown away, the flat one is the cheapest to build
+    CompiledFlatParseContext parse_context(grammar);
+    return nextTokenSuggestionsToSink(parse_context, input_string,
+                                      tokenize(input_string), sink, max_count);
+}
+
+std::vector<std::string> nextTokenCorrections(const CompiledGrammar &grammar,
+                                              std::string_view input_string,
+                                              std::size_t max_distance) {
+    CompiledFlatParseContext parse_context(grammar);
+    return parse_context.getCorrections(
+        parseUntilNextToken(parse_context, input_string,
+                            tokenize(input_string)),
+        max_distance);
+}
+
+// Check if tokenize would not give token back as one token when it is written
+// as is, by running the same quote and escape state machine over it.
+bool needsQuotes(std::string_view token) {
+    if (token.empty() ||
+        (token.size() >= 2 && token.front() == '"' && token.back() == '"')) {
+        return true;
+    }
+    bool inside_quotes = false;
+    bool escaped = false;
+    for (char c : token) {
+        if (c == '"' && !escaped) {
+            inside_quotes = !inside_quotes;
+        }
+        escaped = c == '\\' && !escaped;
+        if (!inside_quotes && c == ' ' && !escaped) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Check if tokenize gives token back from what serializeResult writes for it,
+// without joining it with the following tokens. tokenize has no escape for a
+// literal double quote, so a token leaving the quotes open cannot be written.
+bool canSerializeToken(std::string_view token) {
+    const bool quoted = needsQuotes(token);
+    bool inside_quotes = false;
+    bool escaped = false;
+    auto feed = [&](char c) {
+        if (c == '"' && !escaped) {
+            inside_quotes = !inside_quotes;
+        }
+        escaped = c == '\\' && !escaped;
+        return inside_quotes || c != ' ' || escaped;
+    };
+    if (quoted) {
+        feed('"');
+    }
+    for (char c : token) {
+        if (!feed(c)) {
+            return false;
+        }
+    }
+    if (quoted) {
+        feed('"');
+    }
+    return !inside_quotes;
+}
+
+// Call visitor with the value of every result in preorder, the order tokens
+// were parsed in, without recursing.
+template <class Result, class Visitor>
+void visitResultValues(const Result &result, Visitor &&visitor) {
+    std::vector<const Result *> stack = {&result};
+    while (!stack.empty()) {
+        const Result *current = stack.back();
+        stack.pop_back();
+        visitor(std::string_view(current->m_value));
+        for (auto it = current->m_children.rbegin();
+             it != current->m_children.rend(); ++it) {
+            stack.push_back(&*it);
+        }
+    }
+}
+
+template <class Visitor>
+void visitResultValues(const FlatParseResult &result, Visitor &&visitor) {
+    if (result.empty()) {
+        return;
+    }
+    const auto nodes = result.getNodes();
+    // parents of current whose next siblings are still to be visited
+    std::vector<FlatParseResult::Index> stack;
+    FlatParseResult::Index current = result.getRoot().getIndex();
+    while (true) {
+        visitor(result.getValue(current));
+        if (nodes[current].m_first_child != FlatParseResult::npos) {
+            stack.push_back(current);
+            current = nodes[current].m_first_child;
+            continue;
+        }
+        while (nodes[current].m_next_sibling == FlatParseResult::npos) {
+            if (stack.empty()) {
+                return;
+            }
+            current = stack.back();
+            stack.pop_back();
+        }
+        current = nodes[current].m_next_sibling;
+    }
+}
+
+template <class Result>
+std::size_t getSerializedResultSizeImpl(const Result &result) {
+    std::size_t size = 0;
+    std::size_t count = 0;
+    visitResultValues(result, [&](std::string_view value) {
+        size += value.size() + (needsQuotes(value) ? 2 : 0);
+        ++count;
+    });
+    return count > 0 ? size + count - 1 : 0;
+}
+
+template <class Result>
+void serializeResultImpl(const Result &result, std::string &output) {
+    output.reserve(output.size() + getSerializedResultSizeImpl(result));
+    bool first = true;
+    visitResultValues(result, [&](std::string_view value) {
+        if (!first) {
+            output += ' ';
+        }
+        first = false;
+        if (needsQuotes(value)) {
+            output += '"';
+            output += value;
+            output += '"';
+        } else {
+            output += value;
+        }
+    });
+}
+
+template <class Result> std::string serializeResultImpl(const Result &result) {
+    std::string output;
+    serializeResultImpl(result, output);
+    return output;
+}
+
+std::size_t getSerializedResultSize(const ParseResult &result) {
+    return getSerializedResultSizeImpl(result);
+}
+
+std::size_t getSerializedResultSize(const ParseResultView &result) {
+    return getSerializedResultSizeImpl(result);
+}
+
+std::size_t getSerializedResultSize(const FlatParseResult &result) {
+    return getSerializedResultSizeImpl(result);
+}
+
+template <class Result> bool canSerializeResultImpl(const Result &result) {
+    bool can_serialize = true;
+    visitResultValues(result, [&](std::string_view value) {
+        can_serialize = can_serialize && canSerializeToken(value);
+    });
+    return can_serialize;
+}
+
+bool canSerializeResult(const ParseResult &result) {
+    return canSerializeResultImpl(result);
+}
+
+bool canSerializeResult(const ParseResultView &result) {
+    return canSerializeResultImpl(result);
+}
+
+bool canSerializeResult(const FlatParseResult &result) {
+    return canSerializeResultImpl(result);
+}
+
+std::string serializeResult(const ParseResult &result) {
+    return serializeResultImpl(result);
+}
+
+std::string serializeResult(const ParseResultView &result) {
+    return serializeResultImpl(result);
+}
+
+std::string serializeResult(const FlatParseResult &result) {
+    return serializeResultImpl(result);
+}
+
+void serializeResult(const ParseResult &result, std::string &output) {
+    serializeResultImpl(result, output);
+}
+
+void serializeResult(const ParseResultView &result, std::string &output) {
+    serializeResultImpl(result, output);
+}
+
+void serializeResult(const FlatParseResult &result, std::string &output) {
+    serializeResultImpl(result, output);
+}
+
+void writeSpaces(const TextSink &sink, std::size_t count) {
+    constexpr std::string_view spaces = "                                ";
+    while (count > 0) {
+        const std::size_t n = std::min(count, spaces.size());
+        sink(spaces.substr(0, n));
+        count -= n;
+    }
+}
+
+// Write one help line, the head indented and the description aligned at the
+// margin, or on the next line if the head does not fit.
+void writeHelpLine(const TextSink &sink, int indent, int margin,
+                   std::string_view head, std::string_view description) {
+    writeSpaces(sink, indent);
+    sink(head);
+    const int remaining_space =
+        margin - (indent + 1 + static_cast<int>(head.size()));
+    if (remaining_space > 0) {
+        writeSpaces(sink, remaining_space + 1);
+    } else {
+        sink("\n");
+        writeSpaces(sink, std::max(margin, 0));
+    }
+    sink(description);
+    sink("\n");
+}
+
+void renderHelpImpl(const Component &component, int indent, int margin,
+                    const TextSink &sink) {
+    const auto children = component.getChildren();
+    std::string head = component.getName();
+    for (const Component &child : children) {
+        if (child.isParameter()) {
+            head += " <";
+            head += child.getName();
+            head += ">";
+        }
+    }
+    writeHelpLine(sink, indent, margin, head, component.getDescription());
+
+    for (ComponentType type : {ComponentType::Flag, ComponentType::Command}) {
+        for (const Component &child : children) {
+            if (child.getType() == type) {
+                renderHelpImpl(child, indent + 4, margin, sink);
+            }
+        }
+    }
+}
+
+void renderUsageImpl(const Component &component, bool skip_square_brackets,
+                     const TextSink &sink) {
+    const bool square_brackets =
+        !component.isRequired() && !skip_square_brackets;
+    if (square_brackets) {
+        sink("[");
+    }
+
+    if (component.isParameter()) {
+        sink("<");
+        sink(component.getName());
+        sink(">");
+    } else {
+        sink(component.getName());
+    }
+
+    const auto children = component.getChildren();
+    int n_child = children.size();
+    if (!children.empty()) {
+        sink(" ");
+    }
+
+    // flags
+    bool has_commands = false;
+    for (const Component &child : children) {
+        has_commands = has_commands || child.isCommand();
+        if (child.isFlag()) {
+            renderUsageImpl(child, false, sink);
+            if (--n_child > 0) {
+                sink(" ");
+            }
         }
     }
 
     // commands
-    if (!component.getCommands().empty()) {
-        ss << "<command>";
+    if (has_commands) {
+        sink("<command>");
         if (--n_child > 0) {
-            ss << " ";
+            sink(" ");
         }
     }
 
     // parameters
-    for (const auto &parameter : component.getParameters()) {
-        generateUsageStringImpl(ss, parameter.get());
-        if (--n_child > 0) {
-            ss << " ";
+    for (const Component &child : children) {
+        if (child.isParameter()) {
+            renderUsageImpl(child, false, sink);
+            if (--n_child > 0) {
+                sink(" ");
+            }
         }
     }
 
-    if (!component.isRequired() && !skip_square_brackets) {
-        ss << "]";
+    if (square_brackets) {
+        sink("]");
     }
 }
 
 std::string generateUsageString(const Component &root_component) {
-    std::stringstream ss;
+    std::string usage_string = "Usage: ";
+    renderUsageImpl(root_component, true, [&](std::string_view text) {
+        usage_string += text;
+    });
+    return usage_string;
+}
+
+std::string generateHelpString(const Component &root_component, int margin) {
+    std::string help_string;
+    renderHelpImpl(root_component, 0, margin, [&](std::string_view text) {
+        help_string += text;
+    });
+    return help_string;
+}
 
-    ss << "Usage: ";
+HelpRenderer::HelpRenderer(const Component &root_component, int margin)
+    : m_root_component(&root_component), m_margin(margin) {
+    rebuild();
+}
 
-    generateUsageStringImpl(ss, root_component, true);
+void HelpRenderer::rebuild() {
+    m_entries.clear();
+    m_child_indices.clear();
+    m_entry_indices.clear();
+    m_help_cache.clear();
+    m_usage_cache.clear();
+
+    // breadth first, the entries after the current one are its queue
+    m_entries.push_back({m_root_component, {}, 0, 0, 0, 0});
+    for (std::size_t index = 0; index < m_entries.size(); ++index) {
+        const Component &component = *m_entries[index].m_component;
+        m_entry_indices.emplace(&component, static_cast<Index>(index));
+
+        std::string help_head = component.getName();
+        const auto children = component.getChildren();
+        const auto add_children = [&](ComponentType type) {
+            for (const Component &child : children) {
+                if (child.getType() == type) {
+                    m_child_indices.push_back(
+                        static_cast<Index>(m_entries.size()));
+                    m_entries.push_back({&child, {}, 0, 0, 0, 0});
+                    if (type == ComponentType::Parameter) {
+                        help_head += " <";
+                        help_head += child.getName();
+                        help_head += ">";
+                    }
+                }
+            }
+        };
+        const auto help_children_begin =
+            static_cast<Index>(m_child_indices.size());
+        add_children(ComponentType::Flag);
+        const auto commands_begin = static_cast<Index>(m_child_indices.size());
+        add_children(ComponentType::Command);
+        const auto help_children_end =
+            static_cast<Index>(m_child_indices.size());
+        // parameters are part of the help line, and rendered by usage
+        add_children(ComponentType::Parameter);
+
+        Entry &entry = m_entries[index];
+        entry.m_help_head = std::move(help_head);
+        entry.m_help_children_begin = help_children_begin;
+        entry.m_help_children_end = help_children_end;
+        entry.m_commands_begin = commands_begin;
+        entry.m_parameters_end = static_cast<Index>(m_child_indices.size());
+    }
+}
 
-    return ss.str();
+std::optional<HelpRenderer::Index>
+HelpRenderer::findEntry(const Component &component) const {
+    auto it = m_entry_indices.find(&component);
+    if (it == m_entry_indices.end()) {
+        return std::nullopt;
+    }
+    return it->second;
 }
 
-void generateHelpStringImpl(std::stringstream &ss, const Component &component,
-                            int indent = 0, int margin = 40) {
-    // write root component and description
-    ss << std::string(indent, ' ') << component.getName();
+void HelpRenderer::renderHelpImpl(Index index, int indent,
+                                  const TextSink &sink) const {
+    const Entry &entry = m_entries[index];
+    writeHelpLine(sink, indent, m_margin, entry.m_help_head,
+                  entry.m_component->getDescription());
 
-    // write parameters
-    int parameter_text_size = 0;
-    for (const auto &parameter : component.getParameters()) {
-        ss << " <" << parameter.get().getName() << ">";
-        parameter_text_size += parameter.get().getName().size() + 3;
+    // flags and commands
+    for (Index i = entry.m_help_children_begin; i < entry.m_help_children_end;
+         ++i) {
+        renderHelpImpl(m_child_indices[i], indent + 4, sink);
     }
+}
 
-    // calculate the remaining space for description alignment
-    int remainingSpace = margin - (indent + component.getName().size() + 1 +
-                                   parameter_text_size);
+void HelpRenderer::renderUsageImpl(Index index, bool skip_square_brackets,
+                                   const TextSink &sink) const {
+    const Entry &entry = m_entries[index];
+    const Component &component = *entry.m_component;
+    const bool square_brackets =
+        !component.isRequired() && !skip_square_brackets;
+    if (square_brackets) {
+        sink("[");
+    }
 
-    if (remainingSpace > 0) {
-        ss << std::string(remainingSpace, ' ') << " ";
+    if (component.isParameter()) {
+        sink("<");
+        sink(component.getName());
+        sink(">");
     } else {
-        ss << std::endl << std::string(margin, ' ');
+        sink(component.getName());
+    }
+
+    // separators as in the free renderUsageImpl, which counts every command
+    // as a child but writes them as one <command>
+    Index n_child = entry.m_parameters_end - entry.m_help_children_begin;
+    if (n_child > 0) {
+        sink(" ");
+    }
+
+    // flags
+    for (Index i = entry.m_help_children_begin; i < entry.m_commands_begin;
+         ++i) {
+        renderUsageImpl(m_child_indices[i], false, sink);
+        if (--n_child > 0) {
+            sink(" ");
+        }
     }
 
-    ss << component.getDescription() << std::endl;
+    // commands
+    if (entry.m_commands_begin < entry.m_help_children_end) {
+        sink("<command>");
+        if (--n_child > 0) {
+            sink(" ");
+        }
+    }
 
-    // write flags
-    for (const auto &flag : component.getFlags()) {
-        generateHelpStringImpl(ss, flag.get(), indent + 4, margin);
+    // parameters
+    for (Index i = entry.m_help_children_end; i < entry.m_parameters_end;
+         ++i) {
+        renderUsageImpl(m_child_indices[i], false, sink);
+        if (--n_child > 0) {
+            sink(" ");
+        }
     }
 
-    // write commands
-    for (const auto &command : component.getCommands()) {
-        generateHelpStringImpl(ss, command.get(), indent + 4, margin);
+    if (square_brackets) {
+        sink("]");
     }
 }
 
-std::string generateHelpString(const Component &root_component, int margin) {
-    std::stringstream ss;
+bool HelpRenderer::renderHelp(const Component &component,
+                              const TextSink &sink) {
+    const auto index = findEntry(component);
+    if (!index.has_value()) {
+        return false;
+    }
+    renderHelpImpl(*index, 0, sink);
+    return true;
+}
+
+void HelpRenderer::renderHelp(const TextSink &sink) {
+    renderHelp(*m_root_component, sink);
+}
+
+bool HelpRenderer::renderUsage(const Component &component,
+                               const TextSink &sink) {
+    const auto index = findEntry(component);
+    if (!index.has_value()) {
+        return false;
+    }
+    sink("Usage: ");
+    renderUsageImpl(*index, true, sink);
+    return true;
+}
+
+void HelpRenderer::renderUsage(const TextSink &sink) {
+    renderUsage(*m_root_component, sink);
+}
 
-    generateHelpStringImpl(ss, root_component, 0, margin);
+std::string_view HelpRenderer::getHelpString(const Component &component) {
+    const auto index = findEntry(component);
+    if (!index.has_value()) {
+        return {};
+    }
+    auto [it, inserted] = m_help_cache.try_emplace(*index);
+    if (inserted) {
+        renderHelpImpl(*index, 0, [&](std::string_view text) {
+            it->second += text;
+        });
+    }
+    return it->second;
+}
 
-    return ss.str();
+std::string_view HelpRenderer::getUsageString(const Component &component) {
+    const auto index = findEntry(component);
+    if (!index.has_value()) {
+        return {};
+    }
+    auto [it, inserted] = m_usage_cache.try_emplace(*index);
+    if (inserted) {
+        it->second = "Usage: ";
+        renderUsageImpl(*index, true, [&](std::string_view text) {
+            it->second += text;
+        });
+    }
+    return it->second;
 }
 
 } // namespace optionparser_v2
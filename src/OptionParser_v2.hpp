@@ -3,11 +3,19 @@
 #define RUNTIME_OPTION_PARSER_HEADER
 
 #include <algorithm>
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <memory_resource>
 #include <optional>
-#include <stack>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
 #include <variant>
 #include <vector>
 
@@ -25,6 +33,20 @@ class Component;
 using SuggestionsFunc = std::function<std::vector<std::string>(
     const Component &, std::string_view)>;
 
+/// @brief Receiver of suggestions one at a time.
+/// The string_view is only valid during the call.
+/// @return False to stop, no more suggestions are produced after that.
+using SuggestionSink = std::function<bool(std::string_view)>;
+
+/// @brief Suggestions function pushing into a sink instead of returning a
+/// vector, for components with a large or expensive set of suggestions.
+/// @param component The component to generate suggestions for
+/// @param input_token The input token
+/// @param sink Receiver of the suggestions
+/// @return False if the sink asked to stop.
+using SuggestionsSinkFunc = std::function<bool(
+    const Component &, std::string_view, const SuggestionSink &)>;
+
 /// @brief Default suggestions function for a component.
 /// @param component
 /// @param input_token
@@ -33,6 +55,74 @@ using SuggestionsFunc = std::function<std::vector<std::string>(
 std::vector<std::string> defaultSuggestionsFunc(const Component &component,
                                                 std::string_view input_token);
 
+/// @brief Value of a typed parameter, converted while parsing.
+/// std::monostate for untyped parameters, flags and commands. A choice is
+/// stored as the std::size_t index into ParameterType::getChoices().
+using TypedValue =
+    std::variant<std::monostate, std::int64_t, double, bool, std::size_t>;
+
+/// @brief Type of a parameter, tokens that do not convert to the type are not
+/// accepted by the parameter. Copies share the choice set.
+class ParameterType {
+public:
+    enum class Kind { String, Integer, Float, Boolean, Choice };
+
+    /// @brief Any token, stored as the string only.
+    ParameterType() = default;
+
+    Kind getKind() const;
+
+    /// @brief Convert token with std::from_chars, or look it up in the choice
+    /// set.
+    /// @param token
+    /// @return The converted value, std::monostate for Kind::String, or
+    /// std::nullopt if token is not a valid value.
+    std::optional<TypedValue> convert(std::string_view token) const;
+
+    /// @brief Choices of Kind::Choice, in the order given.
+    std::span<const std::string> getChoices() const;
+
+    /// @brief Get the values starting with input_token, the choices or
+    /// "true" and "false".
+    /// @param input_token
+    /// @return
+    std::vector<std::string> getSuggestions(std::string_view input_token) const;
+
+private:
+    struct ChoiceSet {
+        std::vector<std::string> m_choices;
+        std::unordered_map<std::string_view, std::size_t> m_indices;
+    };
+
+    friend ParameterType makeIntegerType(std::int64_t min, std::int64_t max);
+    friend ParameterType makeFloatType(double min, double max);
+    friend ParameterType makeBooleanType();
+    friend ParameterType makeChoiceType(std::vector<std::string> choices);
+
+    Kind m_kind = Kind::String;
+    std::int64_t m_integer_min = 0;
+    std::int64_t m_integer_max = 0;
+    double m_float_min = 0;
+    double m_float_max = 0;
+    std::shared_ptr<const ChoiceSet> m_choice_set;
+};
+
+/// @brief Integer in [min, max], in decimal.
+ParameterType makeIntegerType(std::int64_t min = INT64_MIN,
+                              std::int64_t max = INT64_MAX);
+
+/// @brief Floating point number in [min, max].
+ParameterType
+makeFloatType(double min = -std::numeric_limits<double>::infinity(),
+              double max = std::numeric_limits<double>::infinity());
+
+/// @brief Boolean, "true", "yes", "on" and "1", or "false", "no", "off" and
+/// "0".
+ParameterType makeBooleanType();
+
+/// @brief One of choices, looked up in a hash table.
+ParameterType makeChoiceType(std::vector<std::string> choices);
+
 class Component {
 public:
     Component(ComponentType type, std::string name, std::string short_name,
@@ -60,6 +150,31 @@ public:
 
     std::vector<std::string> getSuggestions(std::string_view input_token) const;
 
+    /// @brief Push the suggestions for input_token into sink.
+    /// @param input_token
+    /// @param sink
+    /// @return False if the sink asked to stop.
+    bool getSuggestions(std::string_view input_token,
+                        const SuggestionSink &sink) const;
+
+    /// @brief Use a sink based suggestions function, it replaces the
+    /// SuggestionsFunc for both getSuggestions overloads.
+    /// @param suggestions_sink_func
+    void setSuggestionsSinkFunc(SuggestionsSinkFunc suggestions_sink_func);
+
+    /// @brief Check if suggestions come from defaultSuggestionsFunc.
+    /// @return
+    bool hasDefaultSuggestionsFunc() const;
+
+    /// @brief Get the type of a parameter, Kind::String unless it was made
+    /// with makeTypedParameter.
+    /// @return
+    const ParameterType &getParameterType() const;
+
+    /// @brief Set the type of a parameter.
+    /// @param parameter_type
+    void setParameterType(ParameterType parameter_type);
+
 private:
     ComponentType m_type;
     std::string m_name;
@@ -67,7 +182,12 @@ private:
     std::string m_description;
     std::vector<Component> m_children;
     SuggestionsFunc m_suggestions_func;
+    SuggestionsSinkFunc m_suggestions_sink_func;
+    ParameterType m_parameter_type;
     bool m_required;
+
+    // walks m_children in place instead of through getChildren
+    friend class ParseContext;
 };
 
 Component
@@ -81,6 +201,24 @@ Component makeRequiredParameter(
     std::vector<Component> &&children = {},
     SuggestionsFunc suggestions_func = defaultSuggestionsFunc);
 
+/// @brief Suggestions function of typed parameters, the values of the
+/// parameter type starting with input_token, see ParameterType::getSuggestions.
+std::vector<std::string> typedSuggestionsFunc(const Component &component,
+                                              std::string_view input_token);
+
+/// @brief Make a parameter only accepting tokens of parameter_type, parsed
+/// results hold the converted value in m_typed_value. Choice and boolean
+/// parameters suggest their values.
+Component makeTypedParameter(std::string display_name, std::string description,
+                             ParameterType parameter_type,
+                             std::vector<Component> &&children = {},
+                             bool required = false);
+
+Component makeRequiredTypedParameter(std::string display_name,
+                                     std::string description,
+                                     ParameterType parameter_type,
+                                     std::vector<Component> &&children = {});
+
 Component makeFlag(std::string name, std::string short_name,
                    std::string description,
                    std::vector<Component> &&children = {},
@@ -107,11 +245,242 @@ struct ParseResult {
     std::string m_value;
     const Component *m_component;
     std::vector<ParseResult> m_children;
+    // converted value of a typed parameter
+    TypedValue m_typed_value;
+};
+
+/// @brief Non-owning variant of ParseResult.
+/// m_value points into the token storage given to the parser (the input string
+/// for parseView, the tokens for CompiledParseViewContext::parseToken). That
+/// storage must outlive the ParseResultView and must not be modified while the
+/// view is in use.
+struct ParseResultView {
+    std::string_view m_value;
+    const Component *m_component;
+    std::vector<ParseResultView> m_children;
+    TypedValue m_typed_value;
+};
+
+/// @brief ParseResult tree stored in one contiguous node buffer.
+/// Nodes are addressed by index and linked to their first child and next
+/// sibling, and all token text is stored in one shared text buffer. Walking
+/// the tree through NodeRef visits the same values in the same order as
+/// walking ParseResult::m_children.
+class FlatParseResult {
+public:
+    using Index = std::uint32_t;
+
+    static constexpr Index npos = UINT32_MAX;
+
+    struct Node {
+        const Component *m_component;
+        std::uint32_t m_value_offset;
+        std::uint32_t m_value_size;
+        Index m_first_child;
+        Index m_last_child;
+        Index m_next_sibling;
+        // index of the matched CompiledGrammar node, or npos
+        std::uint32_t m_grammar_node;
+        TypedValue m_typed_value;
+    };
+
+    class NodeRef;
+
+    class ChildIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = NodeRef;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = NodeRef;
+
+        ChildIterator() = default;
+        ChildIterator(const FlatParseResult *result, Index index)
+            : m_result(result), m_index(index) {}
+
+        NodeRef operator*() const { return NodeRef(m_result, m_index); }
+        ChildIterator &operator++() {
+            m_index = m_result->m_nodes[m_index].m_next_sibling;
+            return *this;
+        }
+        ChildIterator operator++(int) {
+            ChildIterator it = *this;
+            ++*this;
+            return it;
+        }
+        bool operator==(const ChildIterator &other) const {
+            return m_index == other.m_index;
+        }
+
+    private:
+        const FlatParseResult *m_result = nullptr;
+        Index m_index = npos;
+    };
+
+    class ChildRange {
+    public:
+        ChildRange(ChildIterator begin) : m_begin(begin) {}
+        ChildIterator begin() const { return m_begin; }
+        ChildIterator end() const { return ChildIterator(); }
+        bool empty() const { return m_begin == end(); }
+
+    private:
+        ChildIterator m_begin;
+    };
+
+    /// @brief Lightweight handle to a node, the counterpart of a ParseResult
+    /// reference.
+    class NodeRef {
+    public:
+        NodeRef(const FlatParseResult *result, Index index)
+            : m_result(result), m_index(index) {}
+
+        Index getIndex() const { return m_index; }
+        std::string_view getValue() const {
+            return m_result->getValue(m_index);
+        }
+        const Component *getComponent() const {
+            return m_result->m_nodes[m_index].m_component;
+        }
+        /// @brief Index of the matched node in the CompiledGrammar, or npos
+        /// if the result was not parsed from a CompiledGrammar.
+        std::uint32_t getGrammarNode() const {
+            return m_result->m_nodes[m_index].m_grammar_node;
+        }
+        const TypedValue &getTypedValue() const {
+            return m_result->m_nodes[m_index].m_typed_value;
+        }
+        ChildRange getChildren() const {
+            return ChildRange(ChildIterator(
+                m_result, m_result->m_nodes[m_index].m_first_child));
+        }
+
+    private:
+        const FlatParseResult *m_result;
+        Index m_index;
+    };
+
+    /// @brief Add a node as the last child of parent, or as the root if parent
+    /// is npos. The root must be added first, and only once.
+    /// @param parent
+    /// @param component
+    /// @param value
+    /// @param grammar_node Index of the CompiledGrammar node, or npos
+    /// @param typed_value
+    /// @return Index of the new node
+    Index addNode(Index parent, const Component *component,
+                  std::string_view value, std::uint32_t grammar_node = npos,
+                  TypedValue typed_value = {});
+
+    /// @brief Construct an empty result allocating from resource.
+    explicit FlatParseResult(
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    /// @brief Reserve space, a parse of n tokens needs n nodes and at most the
+    /// input length of text.
+    void reserve(std::size_t node_count, std::size_t text_size);
+
+    bool empty() const;
+    NodeRef getRoot() const;
+    NodeRef getNode(Index index) const;
+    std::span<const Node> getNodes() const;
+    std::string_view getValue(Index index) const;
+
+private:
+    std::pmr::vector<Node> m_nodes;
+    std::pmr::string m_text;
+};
+
+/// @brief Path of components from a root component down to a descendant,
+/// resolved from names once so lookups through a result index do not compare
+/// strings, see makeResultPath.
+class ResultPath {
+public:
+    ResultPath() = default;
+    explicit ResultPath(std::vector<const Component *> components);
+
+    /// @brief The components of the path, the root component first.
+    /// @return
+    std::span<const Component *const> getComponents() const;
+
+private:
+    std::vector<const Component *> m_components;
+};
+
+/// @brief Resolve a path like "git/remote/--verbose" against a component tree.
+/// The first segment is the name of root_component, each following segment is
+/// the name or short name of a child of the previous component. Parameters
+/// are named by their display name.
+/// @param root_component
+/// @param path Segments separated by '/'
+/// @return std::nullopt if a segment does not name a component.
+std::optional<ResultPath> makeResultPath(const Component &root_component,
+                                         std::string_view path);
+
+/// @brief Index of a parse result tree mapping a result and the component of
+/// one of its children to that child, so lookups take O(1) instead of scanning
+/// m_children. Built in one pass over the tree, the result must not be
+/// modified or moved while the index is in use.
+/// @tparam Result ParseResult or ParseResultView
+template <class Result> class BasicParseResultIndex {
+public:
+    explicit BasicParseResultIndex(const Result &root_result);
+
+    /// @brief Find the first child of parent matched to component.
+    /// @param parent A result in the indexed tree
+    /// @param component
+    /// @return nullptr if parent has no such child.
+    const Result *find(const Result &parent, const Component &component) const;
+
+    /// @brief Follow path from the root result, one lookup per level.
+    /// @param path
+    /// @return The first result at the end of path, nullptr if the root result
+    /// does not match the first component or a level is missing.
+    const Result *find(const ResultPath &path) const;
+
+    /// @brief Check if path is present in the result.
+    /// @param path
+    /// @return
+    bool contains(const ResultPath &path) const;
+
+private:
+    using Key = std::pair<const Result *, const Component *>;
+
+    struct KeyHash {
+        std::size_t operator()(const Key &key) const;
+    };
+
+    const Result *m_root;
+    std::unordered_map<Key, const Result *, KeyHash> m_children;
 };
 
+extern template class BasicParseResultIndex<ParseResult>;
+extern template class BasicParseResultIndex<ParseResultView>;
+
+using ParseResultIndex = BasicParseResultIndex<ParseResult>;
+using ParseResultViewIndex = BasicParseResultIndex<ParseResultView>;
+
 /// @brief Parse context for parsing a string.
 class ParseContext {
+    struct Frame {
+        ParseResult *m_parse_result;
+        std::size_t m_parameter_count;
+        // child position the scan for the next parameter starts at
+        std::size_t m_next_parameter;
+        // bit i is set when the required child at position i is parsed
+        std::uint64_t m_required_mask;
+    };
+
 public:
+    /// @brief Saved parse state, see checkpoint and rollback.
+    class Checkpoint {
+        friend class ParseContext;
+        bool m_has_root = false;
+        std::vector<std::size_t> m_child_counts;
+        // frame counters, the pointers are not used by rollback
+        std::vector<Frame> m_stack;
+    };
+
     ParseContext(const std::vector<std::reference_wrapper<const Component>>
                      root_components);
     ParseContext(const std::vector<Component> &root_components);
@@ -127,22 +496,1185 @@ public:
     std::vector<std::string>
     getNextSuggestions(std::string_view token = "") const;
 
+    /// @brief Push the suggestions for the next token into sink, in the same
+    /// order as the vector overload, until the sink asks to stop.
+    /// @return False if the sink asked to stop.
+    bool getNextSuggestions(std::string_view token,
+                            const SuggestionSink &sink) const;
+
     /// @brief Get the root parse result.
     /// @return
     const std::optional<ParseResult> &getRootParseResult() const;
 
+    /// @brief Move the root parse result out of the context, the context is
+    /// empty afterwards.
+    /// @return
+    std::optional<ParseResult> takeRootParseResult();
+
     /// @brief Check if the parse is complete.
     /// A parse is complete if all ParseResults does not have any pending
     /// required children.
     /// @return
     bool isComplete() const;
 
+    /// @brief Save the current parse state.
+    /// Costs O(depth of the parse stack), the tree itself is not copied.
+    /// @return
+    Checkpoint checkpoint() const;
+
+    /// @brief Restore the parse state saved by checkpoint, undoing every
+    /// token parsed since. Checkpoints taken after the one rolled back to are
+    /// invalidated.
+    /// @param checkpoint
+    void rollback(const Checkpoint &checkpoint);
+
 private:
+    static Frame makeFrame(ParseResult &parse_result);
+    static bool frameIsComplete(const Frame &frame);
+
     std::vector<std::reference_wrapper<const Component>> m_root_components;
     std::optional<ParseResult> m_root_parse_result = std::nullopt;
-    std::stack<ParseResult *> m_parse_result_stack;
+    std::vector<Frame> m_parse_result_stack;
+};
+
+/// @brief Component of a grammar defined at compile time, see
+/// makeStaticGrammar. Only holds what the parser needs: names, type,
+/// requiredness and children. Suggestions are always the default ones.
+struct StaticComponent {
+    ComponentType m_type;
+    std::string_view m_name;
+    std::string_view m_short_name;
+    std::vector<StaticComponent> m_children;
+    bool m_required;
+};
+
+constexpr StaticComponent
+makeStaticParameter(std::string_view display_name,
+                    std::vector<StaticComponent> &&children = {},
+                    bool required = false) {
+    return StaticComponent{ComponentType::Parameter, display_name, "",
+                           std::move(children), required};
+}
+
+constexpr StaticComponent
+makeRequiredStaticParameter(std::string_view display_name,
+                            std::vector<StaticComponent> &&children = {}) {
+    return makeStaticParameter(display_name, std::move(children), true);
+}
+
+constexpr StaticComponent
+makeStaticFlag(std::string_view name, std::string_view short_name,
+               std::vector<StaticComponent> &&children = {},
+               bool required = false) {
+    return StaticComponent{ComponentType::Flag, name, short_name,
+                           std::move(children), required};
+}
+
+constexpr StaticComponent
+makeRequiredStaticFlag(std::string_view name, std::string_view short_name,
+                       std::vector<StaticComponent> &&children = {}) {
+    return makeStaticFlag(name, short_name, std::move(children), true);
+}
+
+constexpr StaticComponent
+makeStaticCommand(std::string_view name,
+                  std::vector<StaticComponent> &&children = {},
+                  bool required = false) {
+    return StaticComponent{ComponentType::Command, name, "",
+                           std::move(children), required};
+}
+
+constexpr StaticComponent
+makeRequiredStaticCommand(std::string_view name,
+                          std::vector<StaticComponent> &&children = {}) {
+    return makeStaticCommand(name, std::move(children), true);
+}
+
+/// @brief Sizes of the tables of a StaticGrammar.
+struct StaticGrammarSizes {
+    std::size_t m_node_count;
+    std::size_t m_edge_count;
+    std::size_t m_string_size;
+    std::size_t m_trie_node_count;
+    std::size_t m_bk_tree_node_count;
+    std::size_t m_name_index_size;
+    std::size_t m_custom_suggestions_size;
+};
+
+template <StaticGrammarSizes Sizes> class StaticGrammar;
+
+/// @brief Immutable, flattened form of a Component tree.
+/// The tree is laid out breadth first in one contiguous node array, so the
+/// children of a node are a contiguous index range. Flags, commands and
+/// parameters of each node are precomputed as index ranges into a shared edge
+/// table, and all names are stored in one string table.
+/// The grammar points back into the Component tree it was built from, the tree
+/// must outlive the grammar and must not be mutated while the grammar is used.
+/// The grammar only views its tables, copies share them. A grammar built from
+/// a Component tree owns its tables, a grammar built from a StaticGrammar
+/// views the static tables, which must outlive it.
+class CompiledGrammar {
+public:
+    using NodeIndex = std::uint32_t;
+
+    static constexpr std::uint32_t npos = UINT32_MAX;
+
+    /// @brief Number of required children of a node the parse contexts track
+    /// in a bitmask, the rest are looked up in the parse result.
+    static constexpr std::uint32_t required_mask_size = 64;
+
+    /// @brief How flag and command names are matched against tokens.
+    /// UniquePrefix also accepts any prefix that only leads to one component,
+    /// "git co" is "git commit" if there is no other name starting with "co".
+    /// Exact matches always win over prefix matches.
+    enum class NameMatching { Exact, UniquePrefix };
+
+    /// @brief Node in the name tries. The children of a trie node are stored
+    /// contiguously and sorted by label.
+    struct TrieNode {
+        unsigned char m_label;
+        std::uint32_t m_children_begin;
+        std::uint32_t m_children_end;
+        // component whose name ends here, or npos
+        NodeIndex m_terminal;
+        // the only component reachable from here, or npos
+        NodeIndex m_unique;
+    };
+
+    /// @brief Node in the name BK-trees. Every child of a BK-tree node is at
+    /// edit distance m_distance from it, the children of a node are stored
+    /// contiguously and sorted by distance.
+    struct BkTreeNode {
+        NodeIndex m_node;
+        std::uint32_t m_name_offset;
+        std::uint32_t m_name_size;
+        std::uint32_t m_distance;
+        std::uint32_t m_children_begin;
+        std::uint32_t m_children_end;
+    };
+
+    /// @brief Name found by findSimilarNames.
+    struct SimilarName {
+        NodeIndex m_node;
+        std::string_view m_name;
+        std::size_t m_distance;
+    };
+
+    /// @brief Where the suggestions for the children of a node come from.
+    /// Children using defaultSuggestionsFunc are ranges of the name index,
+    /// sorted by name, every other child with a SuggestionsFunc is in the
+    /// custom suggestions table in declaration order.
+    struct SuggestionIndex {
+        std::uint32_t m_names_begin;
+        std::uint32_t m_names_end;
+        std::uint32_t m_custom_begin;
+        std::uint32_t m_custom_end;
+    };
+
+    struct Node {
+        // nullptr for the nodes of a StaticGrammar
+        const Component *m_component;
+        ComponentType m_type;
+        bool m_required;
+        // parameter with a ParameterType other than Kind::String
+        bool m_typed;
+        // range into the node array, in declaration order
+        NodeIndex m_children_begin;
+        NodeIndex m_children_end;
+        // ranges into the edge table
+        std::uint32_t m_flags_begin;
+        std::uint32_t m_commands_begin;
+        std::uint32_t m_parameters_begin;
+        std::uint32_t m_parameters_end;
+        // ranges into the string table
+        std::uint32_t m_name_offset;
+        std::uint32_t m_name_size;
+        std::uint32_t m_short_name_offset;
+        std::uint32_t m_short_name_size;
+        std::uint32_t m_required_count;
+        // position among the required siblings, or npos if not required
+        std::uint32_t m_required_index;
+        // roots of the name tries, or npos
+        std::uint32_t m_flag_trie;
+        std::uint32_t m_command_trie;
+        SuggestionIndex m_suggestions;
+        // root of the BK-tree over flag and command names, or npos
+        std::uint32_t m_name_bk_tree;
+    };
+
+    /// @brief Component given to TableBuilder. Sources are laid out breadth
+    /// first like the nodes, roots first, and the children of a source are
+    /// the index range m_children_begin to m_children_end.
+    struct SourceNode {
+        const Component *m_component;
+        ComponentType m_type;
+        bool m_required;
+        bool m_default_suggestions;
+        bool m_typed;
+        std::string_view m_name;
+        std::string_view m_short_name;
+        NodeIndex m_children_begin;
+        NodeIndex m_children_end;
+    };
+
+    /// @brief View of the tables of a grammar.
+    struct Tables {
+        std::span<const Node> m_nodes;
+        std::span<const NodeIndex> m_edges;
+        std::string_view m_strings;
+        std::span<const TrieNode> m_trie_nodes;
+        std::span<const BkTreeNode> m_bk_tree_nodes;
+        std::span<const NodeIndex> m_name_index;
+        std::span<const NodeIndex> m_custom_suggestions;
+        SuggestionIndex m_root_suggestions;
+        NodeIndex m_root_count;
+        std::uint32_t m_root_trie;
+        std::uint32_t m_root_bk_tree;
+        NodeIndex m_first_parameter_root;
+        std::size_t m_max_depth;
+    };
+
+    class TableBuilder;
+
+    explicit CompiledGrammar(
+        const std::vector<std::reference_wrapper<const Component>>
+            &root_components,
+        NameMatching name_matching = NameMatching::Exact);
+    explicit CompiledGrammar(const std::vector<Component> &root_components,
+                             NameMatching name_matching = NameMatching::Exact);
+    explicit CompiledGrammar(const Component &root_component,
+                             NameMatching name_matching = NameMatching::Exact);
+
+    /// @brief View tables built elsewhere, they must outlive the grammar.
+    /// @param tables
+    /// @param name_matching
+    explicit CompiledGrammar(const Tables &tables,
+                             NameMatching name_matching = NameMatching::Exact);
+
+    /// @brief View tables kept alive by storage, the grammar and its copies
+    /// share ownership of storage.
+    /// @param tables
+    /// @param storage
+    /// @param name_matching
+    CompiledGrammar(const Tables &tables, std::shared_ptr<const void> storage,
+                    NameMatching name_matching = NameMatching::Exact);
+
+    /// @brief View the tables of a StaticGrammar, no allocation is made.
+    /// @param static_grammar
+    /// @param name_matching
+    template <StaticGrammarSizes Sizes>
+    explicit CompiledGrammar(const StaticGrammar<Sizes> &static_grammar,
+                             NameMatching name_matching = NameMatching::Exact);
+
+    const Tables &getTables() const;
+
+    std::span<const Node> getNodes() const;
+    const Node &getNode(NodeIndex index) const;
+
+    /// @brief Root nodes are always stored first, in the order they were given.
+    std::span<const Node> getRoots() const;
+    std::span<const Node> getChildren(NodeIndex index) const;
+    std::span<const NodeIndex> getFlags(NodeIndex index) const;
+    std::span<const NodeIndex> getCommands(NodeIndex index) const;
+    std::span<const NodeIndex> getParameters(NodeIndex index) const;
+
+    std::string_view getName(NodeIndex index) const;
+    std::string_view getShortName(NodeIndex index) const;
+
+    /// @brief Get the depth of the deepest node, roots have depth 1.
+    std::size_t getMaxDepth() const;
+
+    NameMatching getNameMatching() const;
+
+    /// @brief Find the flag child of a node matching token, in O(token length).
+    /// With NameMatching::UniquePrefix an exact match is returned if there is
+    /// one, otherwise the component the token is a unique prefix of.
+    /// @param index
+    /// @param token
+    /// @param name_matching
+    /// @return
+    std::optional<NodeIndex> findFlag(NodeIndex index, std::string_view token,
+                                      NameMatching name_matching) const;
+
+    /// @brief Find the command child of a node matching token, see findFlag.
+    std::optional<NodeIndex> findCommand(NodeIndex index,
+                                         std::string_view token,
+                                         NameMatching name_matching) const;
+
+    /// @brief Find the root matching token.
+    /// Roots are tried in the order they were given, like ParseContext, so a
+    /// parameter root accepting token shadows every root after it.
+    /// @param token
+    /// @return
+    std::optional<NodeIndex> findRoot(std::string_view token) const;
+
+    /// @brief Convert token to the type of a parameter node, see
+    /// ParameterType::convert.
+    /// @param index
+    /// @param token
+    /// @return std::monostate if the node is not typed, std::nullopt if token
+    /// is not a valid value.
+    std::optional<TypedValue> convertParameter(NodeIndex index,
+                                               std::string_view token) const;
+
+    /// @brief Find the flag and command children of a node using
+    /// defaultSuggestionsFunc whose name starts with prefix, in O(log children).
+    /// @param index Parent node, or npos for the roots.
+    /// @param prefix
+    /// @return Matching nodes, sorted by name.
+    std::span<const NodeIndex> findNamesWithPrefix(NodeIndex index,
+                                                   std::string_view prefix) const;
+
+    /// @brief Find the flag and command children of a node with a name or
+    /// short name within max_distance edits (Levenshtein distance) of token.
+    /// The names are searched in a BK-tree built with the grammar, so only
+    /// part of the names are compared against token.
+    /// @param index Parent node, or npos for the roots.
+    /// @param token
+    /// @param max_distance
+    /// @return One entry per component, with its closest name, sorted by
+    /// distance and then declaration order.
+    std::vector<SimilarName> findSimilarNames(NodeIndex index,
+                                              std::string_view token,
+                                              std::size_t max_distance) const;
+
+    /// @brief Get the children of a node with a SuggestionsFunc other than
+    /// defaultSuggestionsFunc, which have to be asked for their suggestions.
+    /// @param index Parent node, or npos for the roots.
+    /// @return Nodes in declaration order.
+    std::span<const NodeIndex> getCustomSuggestions(NodeIndex index) const;
+
+private:
+    const SuggestionIndex &getSuggestionIndex(NodeIndex index) const;
+    std::optional<NodeIndex> findInTrie(std::uint32_t trie,
+                                        std::string_view token,
+                                        NameMatching name_matching) const;
+
+    Tables m_tables;
+    // owner of the tables, the TableBuilder of a grammar built from a
+    // Component tree or the mapping of a grammar file
+    std::shared_ptr<const void> m_storage;
+    NameMatching m_name_matching;
+};
+
+/// @brief Levenshtein distance between a and b.
+/// @param a
+/// @param b
+/// @param row Scratch space, reused between calls to avoid allocating.
+/// @return
+constexpr std::size_t editDistance(std::string_view a, std::string_view b,
+                                   std::vector<std::size_t> &row) {
+    row.resize(b.size() + 1);
+    for (std::size_t j = 0; j <= b.size(); ++j) {
+        row[j] = j;
+    }
+    for (std::size_t i = 1; i <= a.size(); ++i) {
+        std::size_t diagonal = row[0];
+        row[0] = i;
+        for (std::size_t j = 1; j <= b.size(); ++j) {
+            std::size_t above = row[j];
+            row[j] = std::min({row[j] + 1, row[j - 1] + 1,
+                               diagonal + (a[i - 1] == b[j - 1] ? 0 : 1)});
+            diagonal = above;
+        }
+    }
+    return row[b.size()];
+}
+
+/// @brief Builds the tables of a CompiledGrammar from SourceNodes, and owns
+/// them. Everything is constexpr, so the same code builds the tables of a
+/// Component tree when a CompiledGrammar is constructed and the tables of a
+/// StaticGrammar at compile time.
+class CompiledGrammar::TableBuilder {
+public:
+    /// @brief Build the tables.
+    /// @param sources Components laid out breadth first, see SourceNode.
+    /// @param root_count Number of roots at the start of sources.
+    constexpr TableBuilder(std::span<const SourceNode> sources,
+                           NodeIndex root_count);
+
+    /// @brief View the tables, valid as long as the builder is not modified
+    /// or destroyed.
+    constexpr Tables getTables() const {
+        return Tables{m_nodes,
+                      m_edges,
+                      m_strings,
+                      m_trie_nodes,
+                      m_bk_tree_nodes,
+                      m_name_index,
+                      m_custom_suggestions,
+                      m_root_suggestions,
+                      m_root_count,
+                      m_root_trie,
+                      m_root_bk_tree,
+                      m_first_parameter_root,
+                      m_max_depth};
+    }
+
+    constexpr StaticGrammarSizes getSizes() const {
+        return StaticGrammarSizes{m_nodes.size(),         m_edges.size(),
+                                  m_strings.size(),       m_trie_nodes.size(),
+                                  m_bk_tree_nodes.size(), m_name_index.size(),
+                                  m_custom_suggestions.size()};
+    }
+
+private:
+    using TrieKey = std::pair<std::string_view, NodeIndex>;
+
+    constexpr std::string_view getName(NodeIndex index) const {
+        return std::string_view(m_strings).substr(m_nodes[index].m_name_offset,
+                                                  m_nodes[index].m_name_size);
+    }
+    constexpr std::string_view getShortName(NodeIndex index) const {
+        return std::string_view(m_strings).substr(
+            m_nodes[index].m_short_name_offset,
+            m_nodes[index].m_short_name_size);
+    }
+    constexpr std::uint32_t getStringOffset(std::string_view str) const {
+        return static_cast<std::uint32_t>(str.data() - m_strings.data());
+    }
+
+    constexpr std::uint32_t appendString(std::string_view str);
+    constexpr std::uint32_t numberRequired(NodeIndex begin, NodeIndex end);
+    constexpr SuggestionIndex
+    buildSuggestionIndex(std::span<const SourceNode> sources, NodeIndex begin,
+                         NodeIndex end);
+    constexpr std::uint32_t buildTrie(std::vector<TrieKey> &keys);
+    constexpr void buildTrieNode(std::uint32_t trie,
+                                 std::span<const TrieKey> keys,
+                                 std::size_t depth);
+    constexpr std::uint32_t buildBkTree(std::vector<TrieKey> &keys);
+    constexpr void buildBkTreeChildren(std::uint32_t bk_node,
+                                       std::span<TrieKey> keys);
+
+    std::vector<Node> m_nodes;
+    std::vector<NodeIndex> m_edges;
+    std::string m_strings;
+    std::vector<TrieNode> m_trie_nodes;
+    std::vector<BkTreeNode> m_bk_tree_nodes;
+    std::vector<NodeIndex> m_name_index;
+    std::vector<NodeIndex> m_custom_suggestions;
+    SuggestionIndex m_root_suggestions{};
+    NodeIndex m_root_count = 0;
+    std::uint32_t m_root_trie = npos;
+    std::uint32_t m_root_bk_tree = npos;
+    NodeIndex m_first_parameter_root = npos;
+    std::size_t m_max_depth = 0;
+};
+
+constexpr CompiledGrammar::TableBuilder::TableBuilder(
+    std::span<const SourceNode> sources, NodeIndex root_count)
+    : m_root_count(root_count) {
+    m_nodes.reserve(sources.size());
+    std::vector<std::size_t> depths(sources.size(), 1);
+    for (NodeIndex index = 0; index < sources.size(); ++index) {
+        const SourceNode &source = sources[index];
+        Node node{};
+        node.m_component = source.m_component;
+        node.m_type = source.m_type;
+        node.m_required = source.m_required;
+        node.m_typed = source.m_typed;
+        node.m_children_begin = source.m_children_begin;
+        node.m_children_end = source.m_children_end;
+        node.m_name_offset = appendString(source.m_name);
+        node.m_name_size = source.m_name.size();
+        node.m_short_name_offset = appendString(source.m_short_name);
+        node.m_short_name_size = source.m_short_name.size();
+        node.m_required_index = npos;
+        m_nodes.push_back(node);
+
+        for (NodeIndex child = source.m_children_begin;
+             child < source.m_children_end; ++child) {
+            depths[child] = depths[index] + 1;
+        }
+        m_max_depth = std::max(m_max_depth, depths[index]);
+    }
+
+    numberRequired(0, m_root_count);
+    m_root_suggestions = buildSuggestionIndex(sources, 0, m_root_count);
+
+    for (NodeIndex index = 0; index < m_nodes.size(); ++index) {
+        Node &node = m_nodes[index];
+        auto append_edges = [&](ComponentType type) {
+            for (NodeIndex child = node.m_children_begin;
+                 child < node.m_children_end; ++child) {
+                if (m_nodes[child].m_type == type) {
+                    m_edges.push_back(child);
+                }
+            }
+        };
+        node.m_flags_begin = m_edges.size();
+        append_edges(ComponentType::Flag);
+        node.m_commands_begin = m_edges.size();
+        append_edges(ComponentType::Command);
+        node.m_parameters_begin = m_edges.size();
+        append_edges(ComponentType::Parameter);
+        node.m_parameters_end = m_edges.size();
+
+        node.m_required_count =
+            numberRequired(node.m_children_begin, node.m_children_end);
+        node.m_suggestions = buildSuggestionIndex(
+            sources, node.m_children_begin, node.m_children_end);
+    }
+
+    // name tries, keys are inserted in declaration order so the first
+    // declared component wins if two components share a name
+    std::vector<TrieKey> keys;
+    auto append_keys = [&](NodeIndex index) {
+        keys.emplace_back(getName(index), index);
+        if (m_nodes[index].m_type == ComponentType::Flag) {
+            keys.emplace_back(getShortName(index), index);
+        }
+    };
+    // flags and commands are adjacent in the edge table
+    auto set_keys = [&](std::uint32_t edges_begin, std::uint32_t edges_end) {
+        keys.clear();
+        for (std::uint32_t edge = edges_begin; edge < edges_end; ++edge) {
+            append_keys(m_edges[edge]);
+        }
+    };
+    for (Node &node : m_nodes) {
+        set_keys(node.m_flags_begin, node.m_commands_begin);
+        node.m_flag_trie = buildTrie(keys);
+        set_keys(node.m_commands_begin, node.m_parameters_begin);
+        node.m_command_trie = buildTrie(keys);
+        set_keys(node.m_flags_begin, node.m_parameters_begin);
+        node.m_name_bk_tree = buildBkTree(keys);
+    }
+
+    keys.clear();
+    for (NodeIndex root = 0; root < m_root_count; ++root) {
+        if (m_nodes[root].m_type == ComponentType::Parameter) {
+            m_first_parameter_root = root;
+            break;
+        }
+        append_keys(root);
+    }
+    m_root_trie = buildTrie(keys);
+
+    keys.clear();
+    for (NodeIndex root = 0; root < m_root_count; ++root) {
+        if (m_nodes[root].m_type != ComponentType::Parameter) {
+            append_keys(root);
+        }
+    }
+    m_root_bk_tree = buildBkTree(keys);
+}
+
+constexpr std::uint32_t
+CompiledGrammar::TableBuilder::appendString(std::string_view str) {
+    std::uint32_t offset = m_strings.size();
+    m_strings += str;
+    return offset;
+}
+
+constexpr std::uint32_t
+CompiledGrammar::TableBuilder::numberRequired(NodeIndex begin, NodeIndex end) {
+    std::uint32_t required_count = 0;
+    for (NodeIndex child = begin; child < end; ++child) {
+        if (m_nodes[child].m_required) {
+            m_nodes[child].m_required_index = required_count++;
+        }
+    }
+    return required_count;
+}
+
+constexpr CompiledGrammar::SuggestionIndex
+CompiledGrammar::TableBuilder::buildSuggestionIndex(
+    std::span<const SourceNode> sources, NodeIndex begin, NodeIndex end) {
+    SuggestionIndex index{};
+    index.m_names_begin = m_name_index.size();
+    index.m_custom_begin = m_custom_suggestions.size();
+    for (NodeIndex child = begin; child < end; ++child) {
+        if (!sources[child].m_default_suggestions) {
+            m_custom_suggestions.push_back(child);
+        } else if (sources[child].m_type != ComponentType::Parameter) {
+            // default suggestions of a parameter are always empty
+            m_name_index.push_back(child);
+        }
+    }
+    index.m_names_end = m_name_index.size();
+    index.m_custom_end = m_custom_suggestions.size();
+
+    // ties broken by index, which is declaration order
+    std::sort(m_name_index.begin() + index.m_names_begin, m_name_index.end(),
+              [&](NodeIndex a, NodeIndex b) {
+                  return std::make_pair(getName(a), a) <
+                         std::make_pair(getName(b), b);
+              });
+    return index;
+}
+
+constexpr std::uint32_t
+CompiledGrammar::TableBuilder::buildTrie(std::vector<TrieKey> &keys) {
+    if (keys.empty()) {
+        return npos;
+    }
+    // keys are inserted in index order, so sorting by name and then index
+    // keeps declaration order for equal names
+    std::sort(keys.begin(), keys.end());
+    std::uint32_t trie = m_trie_nodes.size();
+    m_trie_nodes.push_back(TrieNode{0, 0, 0, npos, npos});
+    buildTrieNode(trie, keys, 0);
+    return trie;
+}
+
+constexpr void
+CompiledGrammar::TableBuilder::buildTrieNode(std::uint32_t trie,
+                                             std::span<const TrieKey> keys,
+                                             std::size_t depth) {
+    NodeIndex unique = keys.front().second;
+    for (const auto &key : keys) {
+        if (key.second != unique) {
+            unique = npos;
+            break;
+        }
+    }
+
+    // keys ending here sort first
+    NodeIndex terminal = npos;
+    std::size_t first = 0;
+    for (; first < keys.size() && keys[first].first.size() == depth; ++first) {
+        if (terminal == npos) {
+            terminal = keys[first].second;
+        }
+    }
+
+    std::vector<std::size_t> group_begins;
+    for (std::size_t i = first; i < keys.size(); ++i) {
+        if (i == first || keys[i].first[depth] != keys[i - 1].first[depth]) {
+            group_begins.push_back(i);
+        }
+    }
+    group_begins.push_back(keys.size());
+
+    // children are allocated as one block before recursing
+    std::uint32_t children_begin = m_trie_nodes.size();
+    for (std::size_t group = 0; group + 1 < group_begins.size(); ++group) {
+        unsigned char label = keys[group_begins[group]].first[depth];
+        m_trie_nodes.push_back(TrieNode{label, 0, 0, npos, npos});
+    }
+    TrieNode &node = m_trie_nodes[trie];
+    node.m_children_begin = children_begin;
+    node.m_children_end = m_trie_nodes.size();
+    node.m_terminal = terminal;
+    node.m_unique = unique;
+
+    for (std::size_t group = 0; group + 1 < group_begins.size(); ++group) {
+        buildTrieNode(children_begin + group,
+                      keys.subspan(group_begins[group],
+                                   group_begins[group + 1] -
+                                       group_begins[group]),
+                      depth + 1);
+    }
+}
+
+constexpr std::uint32_t
+CompiledGrammar::TableBuilder::buildBkTree(std::vector<TrieKey> &keys) {
+    std::erase_if(keys, [](const TrieKey &key) { return key.first.empty(); });
+    if (keys.empty()) {
+        return npos;
+    }
+    std::uint32_t root = m_bk_tree_nodes.size();
+    m_bk_tree_nodes.push_back(BkTreeNode{
+        keys.front().second, getStringOffset(keys.front().first),
+        static_cast<std::uint32_t>(keys.front().first.size()), 0, 0, 0});
+    buildBkTreeChildren(root, std::span<TrieKey>(keys).subspan(1));
+    return root;
+}
+
+constexpr void
+CompiledGrammar::TableBuilder::buildBkTreeChildren(std::uint32_t bk_node,
+                                                   std::span<TrieKey> keys) {
+    std::string_view name =
+        std::string_view(m_strings).substr(
+            m_bk_tree_nodes[bk_node].m_name_offset,
+            m_bk_tree_nodes[bk_node].m_name_size);
+
+    // group the keys by distance to this node, the first key of every group
+    // becomes the child for that distance and the rest go below it, ties
+    // keep the order of keys
+    std::vector<std::size_t> row;
+    std::vector<std::pair<std::size_t, std::size_t>> by_distance;
+    by_distance.reserve(keys.size());
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        by_distance.emplace_back(editDistance(keys[i].first, name, row), i);
+    }
+    std::sort(by_distance.begin(), by_distance.end());
+    std::vector<TrieKey> sorted_keys;
+    sorted_keys.reserve(keys.size());
+    for (const auto &[distance, i] : by_distance) {
+        sorted_keys.push_back(keys[i]);
+    }
+    std::copy(sorted_keys.begin(), sorted_keys.end(), keys.begin());
+
+    std::vector<std::pair<std::uint32_t, std::span<TrieKey>>> groups;
+    std::uint32_t children_begin = m_bk_tree_nodes.size();
+    for (std::size_t begin = 0; begin < keys.size();) {
+        std::size_t end = begin + 1;
+        while (end < keys.size() &&
+               by_distance[end].first == by_distance[begin].first) {
+            ++end;
+        }
+        groups.emplace_back(m_bk_tree_nodes.size(),
+                            keys.subspan(begin + 1, end - begin - 1));
+        m_bk_tree_nodes.push_back(BkTreeNode{
+            keys[begin].second, getStringOffset(keys[begin].first),
+            static_cast<std::uint32_t>(keys[begin].first.size()),
+            static_cast<std::uint32_t>(by_distance[begin].first), 0, 0});
+        begin = end;
+    }
+    m_bk_tree_nodes[bk_node].m_children_begin = children_begin;
+    m_bk_tree_nodes[bk_node].m_children_end = m_bk_tree_nodes.size();
+
+    for (auto &[child, child_keys] : groups) {
+        buildBkTreeChildren(child, child_keys);
+    }
+}
+
+/// @brief Tables of a CompiledGrammar built at compile time, see
+/// makeStaticGrammar. Holds no pointers, so it can be a constexpr variable
+/// living in read only data.
+/// @tparam Sizes
+template <StaticGrammarSizes Sizes> class StaticGrammar {
+public:
+    using NodeIndex = CompiledGrammar::NodeIndex;
+
+    constexpr explicit StaticGrammar(
+        const CompiledGrammar::TableBuilder &builder) {
+        const CompiledGrammar::Tables tables = builder.getTables();
+        std::copy(tables.m_nodes.begin(), tables.m_nodes.end(),
+                  m_nodes.begin());
+        std::copy(tables.m_edges.begin(), tables.m_edges.end(),
+                  m_edges.begin());
+        std::copy(tables.m_strings.begin(), tables.m_strings.end(),
+                  m_strings.begin());
+        std::copy(tables.m_trie_nodes.begin(), tables.m_trie_nodes.end(),
+                  m_trie_nodes.begin());
+        std::copy(tables.m_bk_tree_nodes.begin(), tables.m_bk_tree_nodes.end(),
+                  m_bk_tree_nodes.begin());
+        std::copy(tables.m_name_index.begin(), tables.m_name_index.end(),
+                  m_name_index.begin());
+        std::copy(tables.m_custom_suggestions.begin(),
+                  tables.m_custom_suggestions.end(),
+                  m_custom_suggestions.begin());
+        m_root_suggestions = tables.m_root_suggestions;
+        m_root_count = tables.m_root_count;
+        m_root_trie = tables.m_root_trie;
+        m_root_bk_tree = tables.m_root_bk_tree;
+        m_first_parameter_root = tables.m_first_parameter_root;
+        m_max_depth = tables.m_max_depth;
+    }
+
+    /// @brief View the tables, see CompiledGrammar(const Tables &).
+    constexpr CompiledGrammar::Tables getTables() const {
+        return CompiledGrammar::Tables{
+            m_nodes,
+            m_edges,
+            std::string_view(m_strings.data(), m_strings.size()),
+            m_trie_nodes,
+            m_bk_tree_nodes,
+            m_name_index,
+            m_custom_suggestions,
+            m_root_suggestions,
+            m_root_count,
+            m_root_trie,
+            m_root_bk_tree,
+            m_first_parameter_root,
+            m_max_depth};
+    }
+
+private:
+    std::array<CompiledGrammar::Node, Sizes.m_node_count> m_nodes{};
+    std::array<NodeIndex, Sizes.m_edge_count> m_edges{};
+    std::array<char, Sizes.m_string_size> m_strings{};
+    std::array<CompiledGrammar::TrieNode, Sizes.m_trie_node_count>
+        m_trie_nodes{};
+    std::array<CompiledGrammar::BkTreeNode, Sizes.m_bk_tree_node_count>
+        m_bk_tree_nodes{};
+    std::array<NodeIndex, Sizes.m_name_index_size> m_name_index{};
+    std::array<NodeIndex, Sizes.m_custom_suggestions_size>
+        m_custom_suggestions{};
+    CompiledGrammar::SuggestionIndex m_root_suggestions{};
+    NodeIndex m_root_count = 0;
+    std::uint32_t m_root_trie = CompiledGrammar::npos;
+    std::uint32_t m_root_bk_tree = CompiledGrammar::npos;
+    NodeIndex m_first_parameter_root = CompiledGrammar::npos;
+    std::size_t m_max_depth = 0;
+};
+
+template <StaticGrammarSizes Sizes>
+CompiledGrammar::CompiledGrammar(const StaticGrammar<Sizes> &static_grammar,
+                                 NameMatching name_matching)
+    : CompiledGrammar(static_grammar.getTables(), name_matching) {}
+
+/// @brief Build the tables of a StaticComponent tree.
+/// @param root_components
+/// @return
+constexpr CompiledGrammar::TableBuilder
+buildStaticGrammarTables(const std::vector<StaticComponent> &root_components) {
+    // breadth first, so the children of every node end up contiguous
+    std::vector<const StaticComponent *> components;
+    std::vector<CompiledGrammar::SourceNode> sources;
+    auto append_source = [&](const StaticComponent &component) {
+        components.push_back(&component);
+        sources.push_back(CompiledGrammar::SourceNode{
+            nullptr, component.m_type, component.m_required, true, false,
+            component.m_name, component.m_short_name, 0, 0});
+    };
+    for (const StaticComponent &root_component : root_components) {
+        append_source(root_component);
+    }
+    for (std::size_t index = 0; index < components.size(); ++index) {
+        CompiledGrammar::NodeIndex children_begin = sources.size();
+        for (const StaticComponent &child : components[index]->m_children) {
+            append_source(child);
+        }
+        sources[index].m_children_begin = children_begin;
+        sources[index].m_children_end = sources.size();
+    }
+    return CompiledGrammar::TableBuilder(
+        sources, static_cast<CompiledGrammar::NodeIndex>(root_components.size()));
+}
+
+constexpr CompiledGrammar::TableBuilder
+buildStaticGrammarTables(const StaticComponent &root_component) {
+    return buildStaticGrammarTables(
+        std::vector<StaticComponent>{root_component});
+}
+
+/// @brief Build a grammar at compile time.
+/// The StaticComponent tree returned by make is flattened into the same
+/// tables a CompiledGrammar builds from a Component tree, so nothing is
+/// allocated or initialized at startup. View it with a CompiledGrammar to use
+/// it with parse, parseFlat, nextTokenSuggestions and the compiled contexts.
+///
+///     constexpr StaticComponent makeGit() {
+///         return makeStaticCommand("git", {makeStaticCommand("status")});
+///     }
+///     constexpr auto git_grammar = makeStaticGrammar<makeGit>();
+///     CompiledGrammar grammar(git_grammar);
+///
+/// There are no Component objects behind a static grammar, so the
+/// m_component of ParseResult and ParseResultView is nullptr, use parseFlat
+/// and FlatParseResult::NodeRef::getGrammarNode to tell the matches apart.
+/// A component may have at most CompiledGrammar::required_mask_size required
+/// children.
+/// @tparam Make Constexpr function returning the root StaticComponent, or a
+/// std::vector of roots.
+/// @return
+template <auto Make> consteval auto makeStaticGrammar() {
+    constexpr std::pair<StaticGrammarSizes, bool> sizes = [] {
+        const auto builder = buildStaticGrammarTables(Make());
+        bool masks_fit = true;
+        for (const auto &node : builder.getTables().m_nodes) {
+            if (node.m_required_count > CompiledGrammar::required_mask_size) {
+                masks_fit = false;
+            }
+        }
+        return std::make_pair(builder.getSizes(), masks_fit);
+    }();
+    static_assert(sizes.second,
+                  "too many required children in a static grammar component");
+    return StaticGrammar<sizes.first>(buildStaticGrammarTables(Make()));
+}
+
+/// @brief Serialize the tables of a grammar into the binary grammar format.
+/// The format is versioned and stores the tables exactly as CompiledGrammar
+/// uses them, so loadGrammar and mapGrammarFile use the bytes in place
+/// without deserializing. It is only readable on machines with the same byte
+/// order and struct layout as the writer. Component pointers and suggestion
+/// functions are not stored, a loaded grammar suggests the names of flags and
+/// commands only, and its results have a null m_component, see
+/// makeStaticGrammar.
+/// @param root_components
+/// @return The file contents.
+std::string serializeGrammar(
+    const std::vector<std::reference_wrapper<const Component>>
+        &root_components);
+std::string serializeGrammar(const std::vector<Component> &root_components);
+std::string serializeGrammar(const Component &root_component);
+
+/// @brief View a grammar in the binary grammar format, in O(1).
+/// Only the header and section bounds are checked, data is trusted to come
+/// from serializeGrammar.
+/// @param data Contents written by serializeGrammar, aligned to 8 bytes. Must
+/// outlive the grammar.
+/// @param name_matching
+/// @return The grammar, or std::nullopt if data is not a grammar of this
+/// format version and layout.
+std::optional<CompiledGrammar> loadGrammar(
+    std::string_view data,
+    CompiledGrammar::NameMatching name_matching =
+        CompiledGrammar::NameMatching::Exact);
+
+/// @brief Map a grammar file written from serializeGrammar read only into
+/// memory and view it, see loadGrammar. Processes mapping the same file share
+/// its pages in the page cache. The mapping is owned by the grammar and its
+/// copies, and is unmapped with the last of them.
+/// @param path
+/// @param name_matching
+/// @return The grammar, or std::nullopt if the file cannot be mapped or is
+/// not a grammar file.
+std::optional<CompiledGrammar> mapGrammarFile(
+    const std::string &path, CompiledGrammar::NameMatching name_matching =
+                                 CompiledGrammar::NameMatching::Exact);
+
+/// @brief Parse context running on a CompiledGrammar.
+/// Gives the same results as ParseContext, but does not allocate anything
+/// per token apart from the result that is appended to the result tree.
+/// @tparam Result ParseResult, or ParseResultView to store the tokens without
+/// copying them.
+template <class Result> class BasicCompiledParseContext {
+    // results are addressed by pointer in trees, by index in flat results
+    using Handle = std::conditional_t<std::is_same_v<Result, FlatParseResult>,
+                                      FlatParseResult::Index, Result *>;
+
+    struct Frame {
+        Handle m_result;
+        CompiledGrammar::NodeIndex m_node;
+        std::size_t m_parameter_count;
+        // bit m_required_index is set for each required child parsed
+        std::uint64_t m_required_mask;
+        // first word of the bits of required children past the mask in
+        // m_required_overflow, for nodes with more required children
+        std::uint32_t m_overflow_begin;
+    };
+
+public:
+    /// @brief Saved parse state, see checkpoint and rollback.
+    class Checkpoint {
+        friend class BasicCompiledParseContext;
+        bool m_has_root = false;
+        std::vector<Frame> m_stack;
+        std::vector<std::uint64_t> m_required_overflow;
+        std::vector<std::size_t> m_child_counts;
+    };
+
+    /// @brief Construct a context for grammar.
+    /// The stack and FlatParseResult buffers are allocated from resource,
+    /// ParseResult and ParseResultView always use the default allocator.
+    /// @param grammar
+    /// @param resource
+    explicit BasicCompiledParseContext(
+        const CompiledGrammar &grammar,
+        std::pmr::memory_resource *resource = std::pmr::get_default_resource());
+
+    /// @brief Add and parse token in context, and update the parse result.
+    /// @param token
+    /// @return True if the token was successfully parsed, false otherwise.
+    bool parseToken(std::string_view token);
+
+    /// @brief Get the suggestions for the next token.
+    /// @return
+    std::vector<std::string>
+    getNextSuggestions(std::string_view token = "") const;
+
+    /// @brief Get the suggestions for the next token, allocated from resource.
+    /// @return
+    std::pmr::vector<std::pmr::string>
+    getNextSuggestions(std::string_view token,
+                       std::pmr::memory_resource *resource) const;
+
+    /// @brief Push the suggestions for the next token into sink, see
+    /// ParseContext::getNextSuggestions.
+    /// @return False if the sink asked to stop.
+    bool getNextSuggestions(std::string_view token,
+                            const SuggestionSink &sink) const;
+
+    /// @brief Get "did you mean" corrections for a token, the flag and
+    /// command names that could come next and are within max_distance edits
+    /// of token, see CompiledGrammar::findSimilarNames.
+    /// @param token
+    /// @param max_distance
+    /// @return Closest names first.
+    std::vector<std::string> getCorrections(std::string_view token,
+                                            std::size_t max_distance = 2) const;
+
+    /// @brief Get the root parse result.
+    /// @return
+    const std::optional<Result> &getRootParseResult() const;
+
+    /// @brief Move the root parse result out of the context, the context is
+    /// empty afterwards.
+    /// @return
+    std::optional<Result> takeRootParseResult();
+
+    /// @brief Reserve the buffers of the FlatParseResult, see
+    /// FlatParseResult::reserve.
+    void reserve(std::size_t node_count, std::size_t text_size)
+        requires std::is_same_v<Result, FlatParseResult>;
+
+    /// @brief Check if the parse is complete.
+    /// @return
+    bool isComplete() const;
+
+    /// @brief Save the current parse state, see ParseContext::checkpoint.
+    /// Not available for FlatParseResult.
+    Checkpoint checkpoint() const
+        requires(!std::is_same_v<Result, FlatParseResult>);
+
+    /// @brief Restore the parse state saved by checkpoint, see
+    /// ParseContext::rollback.
+    void rollback(const Checkpoint &checkpoint)
+        requires(!std::is_same_v<Result, FlatParseResult>);
+
+private:
+    bool frameIsComplete(const Frame &frame) const;
+    void pushFrame(Handle result, CompiledGrammar::NodeIndex node);
+    void popFrame();
+    Handle emplaceRoot(CompiledGrammar::NodeIndex node, std::string_view token,
+                       TypedValue typed_value);
+    Handle emplaceChild(Handle parent, CompiledGrammar::NodeIndex node,
+                        std::string_view token, TypedValue typed_value);
+
+    const CompiledGrammar *m_grammar;
+    std::optional<Result> m_root_parse_result = std::nullopt;
+    std::pmr::vector<Frame> m_stack;
+    // bits of required children past the mask, a range per frame in stack
+    // order, only used by nodes with more than required_mask_size required
+    // children
+    std::pmr::vector<std::uint64_t> m_required_overflow;
+    std::size_t m_reserve_node_count = 0;
+    std::size_t m_reserve_text_size = 0;
+};
+
+extern template class BasicCompiledParseContext<ParseResult>;
+extern template class BasicCompiledParseContext<ParseResultView>;
+extern template class BasicCompiledParseContext<FlatParseResult>;
+
+using CompiledParseContext = BasicCompiledParseContext<ParseResult>;
+using CompiledParseViewContext = BasicCompiledParseContext<ParseResultView>;
+using CompiledFlatParseContext = BasicCompiledParseContext<FlatParseResult>;
+
+/// @brief Streaming front-end for a parse context.
+/// Accepts input in arbitrary chunks, for example as it is read from a pipe or
+/// a socket, and feeds every completed token straight into the context. Tokens
+/// are split exactly like tokenize splits the concatenated input. Open quotes
+/// and pending escapes carry over chunk boundaries, and only a token that
+/// straddles a boundary is copied, into an internal buffer.
+/// @tparam Context ParseContext, CompiledParseContext or
+/// CompiledFlatParseContext. Contexts storing views of the tokens cannot be
+/// used, as the chunks do not outlive the call to feed.
+template <class Context> class StreamParser {
+public:
+    explicit StreamParser(Context &context);
+
+    /// @brief Feed the next chunk of input.
+    /// @param chunk
+    /// @return False if the context rejected a token, the rest of the input
+    /// is ignored after that.
+    bool feed(std::string_view chunk);
+
+    /// @brief Signal end of input, the last token is parsed if pending.
+    /// @return False if the context rejected a token.
+    bool finish();
+
+    /// @brief Check if the context rejected a token.
+    bool failed() const;
+
+    Context &getContext();
+    const Context &getContext() const;
+
+private:
+    bool parseToken(std::string_view token);
+
+    Context *m_context;
+    std::string m_partial_token;
+    bool m_inside_quotes = false;
+    bool m_escaped = false;
+    bool m_failed = false;
 };
 
+extern template class StreamParser<ParseContext>;
+extern template class StreamParser<CompiledParseContext>;
+extern template class StreamParser<CompiledFlatParseContext>;
+
+/// @brief Incremental completion for an interactive line editor.
+/// Keeps the line being edited and a parse context holding every complete
+/// token of it, with a checkpoint before each token. An edit only rolls the
+/// context back to the first token it touches and parses the tokens after
+/// it, so appending or erasing at the end of the line costs the same no
+/// matter how long the line is. Suggestions are the same as
+/// nextTokenSuggestions on the whole line.
+/// @tparam Context ParseContext or CompiledParseContext. The context must be
+/// empty when the session is created and is owned by the session afterwards.
+template <class Context> class CompletionSession {
+public:
+    explicit CompletionSession(Context &context);
+
+    /// @brief Append text at the end of the line, for example a keystroke.
+    /// @param text
+    void append(std::string_view text);
+
+    /// @brief Erase characters from the end of the line, for example a
+    /// backspace.
+    /// @param count Number of characters, clamped to the line length.
+    void erase(std::size_t count = 1);
+
+    /// @brief Replace the whole line, only the part after the common prefix
+    /// of the old and the new line is parsed again.
+    /// @param line
+    void setLine(std::string_view line);
+
+    /// @brief Get the suggestions for the next token of the line.
+    /// @return Same as nextTokenSuggestions on getLine().
+    std::vector<std::string> getNextSuggestions() const;
+
+    /// @brief Push the suggestions for the next token of the line into sink.
+    /// @return False if the sink asked to stop.
+    bool getNextSuggestions(const SuggestionSink &sink) const;
+
+    const std::string &getLine() const;
+    const Context &getContext() const;
+
+private:
+    struct Token {
+        std::size_t m_begin;
+        std::size_t m_end;
+    };
+
+    void update(std::size_t unchanged_size);
+    std::string_view getToken(std::size_t index) const;
+
+    Context *m_context;
+    std::string m_line;
+    // raw token ranges of m_line, quotes included
+    std::vector<Token> m_tokens;
+    // m_checkpoints[i] is the state before m_tokens[i] was parsed
+    std::vector<typename Context::Checkpoint> m_checkpoints;
+    bool m_failed = false;
+};
+
+extern template class CompletionSession<ParseContext>;
+extern template class CompletionSession<CompiledParseContext>;
+
+/// @brief Split the input string into tokens.
+/// Tokens are separated by spaces, spaces inside double quotes do not split,
+/// and surrounding quotes are removed. A double quote preceded by a backslash
+/// does not open or close quotes, the backslash is kept in the token. There is
+/// no escape for spaces outside quotes.
+/// @param input_string
+/// @return Tokens pointing into input_string
+std::vector<std::string_view> tokenize(std::string_view input_string);
+std::pmr::vector<std::string_view> tokenize(std::string_view input_string,
+                                            std::pmr::memory_resource *resource);
+
+/// @brief Implementations of tokenize. The SIMD backends build quote,
+/// backslash and space bitmasks for 64 bytes at a time and give the same tokens
+/// as the scalar byte loop.
+enum class TokenizerBackend { Scalar, Sse42, Avx2 };
+
+/// @brief Check if the backend is compiled in and supported by the CPU.
+bool isTokenizerBackendSupported(TokenizerBackend backend);
+
+/// @brief Get the backend tokenize uses, the best one supported by the CPU.
+TokenizerBackend getTokenizerBackend();
+
+/// @brief Tokenize with a specific backend, the backend must be supported.
+std::vector<std::string_view> tokenize(std::string_view input_string,
+                                       TokenizerBackend backend);
+
 /// @brief Parse the input string
 /// @param root_component The root component of the parser (AST root)
 /// @param input_string The input string to parse
@@ -164,6 +1696,79 @@ std::optional<ParseResult> parseMultiRef(
     const std::vector<std::reference_wrapper<const Component>> &root_components,
     std::string_view input_string);
 
+/// @brief Parse the input string with a compiled grammar.
+/// The roots of the grammar are tried in order, like parseMulti.
+/// @param grammar
+/// @param input_string
+/// @return
+std::optional<ParseResult> parse(const CompiledGrammar &grammar,
+                                 std::string_view input_string);
+
+/// @brief Parse the input string with a compiled grammar without copying any
+/// tokens. The returned values point into input_string, so input_string must
+/// outlive the result.
+/// @param grammar
+/// @param input_string
+/// @return
+std::optional<ParseResultView> parseView(const CompiledGrammar &grammar,
+                                         std::string_view input_string);
+
+/// @brief Parse the input string with a compiled grammar into a
+/// FlatParseResult. The result buffers are reserved up front, so the whole
+/// parse does a constant number of allocations.
+/// @param grammar
+/// @param input_string
+/// @return
+std::optional<FlatParseResult> parseFlat(const CompiledGrammar &grammar,
+                                         std::string_view input_string);
+
+/// @brief Parse into a FlatParseResult, with the tokens, the parse stack and
+/// the result all allocated from resource. With a
+/// std::pmr::monotonic_buffer_resource the whole parse is released at once
+/// when the resource is, the resource must outlive the result.
+/// @param grammar
+/// @param input_string
+/// @param resource
+/// @return
+std::optional<FlatParseResult> parseFlat(const CompiledGrammar &grammar,
+                                         std::string_view input_string,
+                                         std::pmr::memory_resource *resource);
+
+/// @brief Parse many input strings in parallel.
+/// The inputs are split into one range per thread, and a thread that finishes
+/// its range steals work from the ranges of the others. Results are returned in
+/// input order.
+///
+/// Thread safety: a const Component tree and a CompiledGrammar may be shared by
+/// any number of concurrent parses, nothing in them is modified when parsing.
+/// Parsing never calls suggestions functions. The suggestions functions of a
+/// shared tree are called concurrently if suggestions are requested from several
+/// threads, so they must be safe to call concurrently, which
+/// defaultSuggestionsFunc is. Mutating a tree, through getChildrenMutable, while
+/// it is used by any parse is not allowed.
+/// @param root_component
+/// @param input_strings
+/// @param thread_count Number of threads to use, 0 for
+/// std::thread::hardware_concurrency()
+/// @return One result per input string
+std::vector<std::optional<ParseResult>>
+parseBatch(const Component &root_component,
+           std::span<const std::string_view> input_strings,
+           std::size_t thread_count = 0);
+
+/// @brief Like parseBatch, trying the root components in order like
+/// parseMulti.
+std::vector<std::optional<ParseResult>>
+parseBatchMulti(const std::vector<Component> &root_components,
+                std::span<const std::string_view> input_strings,
+                std::size_t thread_count = 0);
+
+/// @brief Like parseBatch, with a compiled grammar.
+std::vector<std::optional<ParseResult>>
+parseBatch(const CompiledGrammar &grammar,
+           std::span<const std::string_view> input_strings,
+           std::size_t thread_count = 0);
+
 /// @brief Get the last parse result from the parse result.
 /// @param parse_result
 /// @return The last parse result
@@ -186,7 +1791,85 @@ std::vector<std::string> nextTokenSuggestionsMultiRef(
     const std::vector<std::reference_wrapper<const Component>> &root_components,
     const std::string_view &input_string);
 
+std::vector<std::string>
+nextTokenSuggestions(const CompiledGrammar &grammar,
+                     const std::string_view &input_string);
+
+/// @brief Get the next token suggestions, with the tokens, the parse state and
+/// the returned suggestions allocated from resource.
+/// Suggestions functions still return std::vector<std::string>, their
+/// temporaries use the default allocator.
+std::pmr::vector<std::pmr::string>
+nextTokenSuggestions(const CompiledGrammar &grammar,
+                     const std::string_view &input_string,
+                     std::pmr::memory_resource *resource);
+
+/// @brief Push the next token suggestions into sink instead of returning them.
+/// Suggestions come in the same order as from the vector overloads, and
+/// production stops as soon as the sink returns false or max_count
+/// suggestions have been pushed, so only the first max_count are ever
+/// generated by sink based suggestions functions.
+/// @param root_component
+/// @param input_string
+/// @param sink
+/// @param max_count
+/// @return Number of suggestions pushed into sink.
+std::size_t nextTokenSuggestions(const Component &root_component,
+                                 std::string_view input_string,
+                                 const SuggestionSink &sink,
+                                 std::size_t max_count = SIZE_MAX);
+std::size_t
+nextTokenSuggestionsMulti(const std::vector<Component> &root_components,
+                          std::string_view input_string,
+                          const SuggestionSink &sink,
+                          std::size_t max_count = SIZE_MAX);
+std::size_t nextTokenSuggestions(const CompiledGrammar &grammar,
+                                 std::string_view input_string,
+                                 const SuggestionSink &sink,
+                                 std::size_t max_count = SIZE_MAX);
+
+/// @brief Get "did you mean" corrections for the token that would be
+/// completed by nextTokenSuggestions, usually the token that did not parse.
+/// @param grammar
+/// @param input_string
+/// @param max_distance Maximum number of edits
+/// @return Closest names first.
+std::vector<std::string> nextTokenCorrections(const CompiledGrammar &grammar,
+                                              std::string_view input_string,
+                                              std::size_t max_distance = 2);
+
+/// @brief Check if tokenize gives back every token of the serialized result.
+/// @param result
+/// @return false if a token has double quotes tokenize cannot read back.
+bool canSerializeResult(const ParseResult &result);
+bool canSerializeResult(const ParseResultView &result);
+bool canSerializeResult(const FlatParseResult &result);
+
+/// @brief Serialize a parse result to its tokens in parse order, separated by
+/// spaces. Tokens tokenize would split or strip are wrapped in double quotes,
+/// so tokenize gives the tokens back if canSerializeResult(result) is true.
+/// tokenize has no escape for a literal double quote, a token with unbalanced
+/// quotes like a"b, e.g. from argv, is joined with the tokens following it.
+/// The tree is walked without recursion and the output is allocated once.
+/// @param result
+/// @return
 std::string serializeResult(const ParseResult &result);
+std::string serializeResult(const ParseResultView &result);
+std::string serializeResult(const FlatParseResult &result);
+
+/// @brief Append the serialized result to output, growing it at most once.
+/// @param result
+/// @param output
+void serializeResult(const ParseResult &result, std::string &output);
+void serializeResult(const ParseResultView &result, std::string &output);
+void serializeResult(const FlatParseResult &result, std::string &output);
+
+/// @brief Get the exact length of the serialized result.
+/// @param result
+/// @return
+std::size_t getSerializedResultSize(const ParseResult &result);
+std::size_t getSerializedResultSize(const ParseResultView &result);
+std::size_t getSerializedResultSize(const FlatParseResult &result);
 
 /// @brief Generate a usage string for the given component.
 /// @param root_component
@@ -199,6 +1882,80 @@ std::string generateUsageString(const Component &root_component);
 std::string generateHelpString(const Component &root_component,
                                int margin = 40);
 
+/// @brief Receiver of rendered text, called with consecutive pieces of the
+/// output. The string_view is only valid during the call.
+using TextSink = std::function<void(std::string_view)>;
+
+/// @brief Help and usage renderer for a component tree, giving the same text
+/// as generateHelpString and generateUsageString.
+/// The tree is frozen into a table with the children of every component split
+/// into flags, commands and parameters, and the width of every help line
+/// measured, so rendering only writes text. Any component of the tree can be
+/// rendered on its own, and rendered strings are cached. Like CompiledGrammar
+/// the renderer does not see changes to the tree, call rebuild after mutating
+/// it. The root component must outlive the renderer and must not be moved.
+class HelpRenderer {
+public:
+    explicit HelpRenderer(const Component &root_component, int margin = 40);
+
+    /// @brief Write the help of component and its descendants into sink,
+    /// component first at no indent.
+    /// @param component A component of the tree
+    /// @param sink
+    /// @return False if component is not in the tree.
+    bool renderHelp(const Component &component, const TextSink &sink);
+    void renderHelp(const TextSink &sink);
+
+    /// @brief Write the usage of component into sink.
+    /// @param component A component of the tree
+    /// @param sink
+    /// @return False if component is not in the tree.
+    bool renderUsage(const Component &component, const TextSink &sink);
+    void renderUsage(const TextSink &sink);
+
+    /// @brief Get the help of component, rendered on the first call.
+    /// @param component A component of the tree
+    /// @return Empty if component is not in the tree. Valid until rebuild.
+    std::string_view getHelpString(const Component &component);
+
+    /// @brief Get the usage of component, rendered on the first call.
+    /// @param component A component of the tree
+    /// @return Empty if component is not in the tree. Valid until rebuild.
+    std::string_view getUsageString(const Component &component);
+
+    /// @brief Rebuild the table from the tree and drop the cached strings.
+    /// Must be called after the tree was mutated, before rendering again.
+    void rebuild();
+
+private:
+    using Index = std::uint32_t;
+
+    struct Entry {
+        const Component *m_component;
+        // name, and parameters for help lines
+        std::string m_help_head;
+        // range of m_child_indices, flags then commands
+        Index m_help_children_begin;
+        Index m_help_children_end;
+        // first command, and end of the parameters following the commands
+        Index m_commands_begin;
+        Index m_parameters_end;
+    };
+
+    std::optional<Index> findEntry(const Component &component) const;
+    void renderHelpImpl(Index index, int indent, const TextSink &sink) const;
+    void renderUsageImpl(Index index, bool skip_square_brackets,
+                         const TextSink &sink) const;
+
+    const Component *m_root_component;
+    int m_margin;
+    std::vector<Entry> m_entries;
+    std::vector<Index> m_child_indices;
+    std::unordered_map<const Component *, Index> m_entry_indices;
+    std::unordered_map<Index, std::string> m_help_cache;
+    std::unordered_map<Index, std::string> m_usage_cache;
+};
+
 } // namespace optionparser_v2
 
 #endif // !RUNTIME_OPTION_PARSER_HEADER
\ No newline at end of file
@@ -1,5 +1,6 @@
 
 #include <OptionParser.hpp>
+#include <stdexcept>
 #include <string>
 #include <unistd.h>
 
@@ -153,3 +154,351 @@ TEST(OptionParser, MultiOptionFail) {
     EXPECT_TRUE(res.has_value());
     EXPECT_EQ(res->get<0>(), 4);
 }
+
+TEST(OptionParser, StaticOption) {
+    using namespace OptionParser;
+    Parser parser(StaticOption<Identifiers<"-a", "--alpha">, NumberType<int>>{},
+                  StaticOption<Identifiers<"-b">, NumberType<int>>{},
+                  StaticOption<Identifiers<"-w">, ListType>{},
+                  StaticOption<Identifiers<"-w">, WordType>{},
+                  StaticOption<Identifiers<"-v">>{});
+
+    std::string input_string = "--alpha 1 -b notnumber -w word -v -b 2";
+
+    auto set = parser.parse(input_string);
+    auto res = set.find<0>();
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res->get<0>(), 1);
+    res = set.find<1>();
+    EXPECT_TRUE(res.has_value());
+    EXPECT_EQ(res->get<0>(), 2);
+    // the list option does not parse, so the word option with the same
+    // identifier is tried next
+    EXPECT_FALSE(set.find<2>().has_value());
+    auto word_res = set.find<3>();
+    EXPECT_TRUE(word_res.has_value());
+    EXPECT_EQ(word_res->get<0>(), "word");
+    EXPECT_TRUE(set.find<4>().has_value());
+}
+
+TEST(OptionParser, StaticOptionSameAsOption) {
+    using namespace OptionParser;
+    Parser parser(Option<WordType>("gcc"), Option<NumberType<int>>("-O"),
+                  Option<ListType>("-D"), Option<WordType>("-D"),
+                  Option<WordType>("-o", "--output"));
+    Parser static_parser(
+        StaticOption<Identifiers<"gcc">, WordType>{},
+        StaticOption<Identifiers<"-O">, NumberType<int>>{},
+        StaticOption<Identifiers<"-D">, ListType>{},
+        StaticOption<Identifiers<"-D">, WordType>{},
+        StaticOption<Identifiers<"-o", "--output">, WordType>{});
+    // a parser mixing both kinds tries the options in order
+    Parser mixed_parser(StaticOption<Identifiers<"gcc">, WordType>{},
+                        Option<NumberType<int>>("-O"),
+                        StaticOption<Identifiers<"-D">, ListType>{},
+                        Option<WordType>("-D"),
+                        Option<WordType>("-o", "--output"));
+
+    for (std::string input_string :
+         {"gcc main.cpp -O 3 -D [A=1, B] --output main",
+          "gcc -O x -D A -o main main.cpp", " ,-D [A -O 2 gcc"}) {
+        auto set = parser.parse(input_string);
+        auto static_set = static_parser.parse(input_string);
+        auto mixed_set = mixed_parser.parse(input_string);
+        EXPECT_EQ(set.find<0>().has_value(), static_set.find<0>().has_value());
+        EXPECT_EQ(set.find<0>().has_value(), mixed_set.find<0>().has_value());
+        if (set.find<0>() && static_set.find<0>()) {
+            EXPECT_EQ(set.find<0>()->get<0>(), static_set.find<0>()->get<0>());
+        }
+        EXPECT_EQ(set.find<1>().has_value(), static_set.find<1>().has_value());
+        EXPECT_EQ(set.find<2>().has_value(), static_set.find<2>().has_value());
+        EXPECT_EQ(set.find<2>().has_value(), mixed_set.find<2>().has_value());
+        EXPECT_EQ(set.find<3>().has_value(), static_set.find<3>().has_value());
+        EXPECT_EQ(set.find<4>().has_value(), static_set.find<4>().has_value());
+        if (set.find<4>() && static_set.find<4>()) {
+            EXPECT_EQ(set.find<4>()->get<0>(), static_set.find<4>()->get<0>());
+        }
+    }
+}
+
+template <OptionParser::DelimSet delim_set>
+std::vector<std::string_view> extractWordsWith(std::string_view str_view) {
+    return OptionParser::extractWords(str_view, delim_set);
+}
+
+TEST(OptionParser, DelimSet) {
+    using namespace OptionParser;
+    constexpr DelimSet delim_set(" \t,");
+    static_assert(delim_set.contains(','));
+    static_assert(!delim_set.contains('a'));
+    static_assert(default_delim_set.contains('\t'));
+
+    // long enough for the SIMD kernels, and with a short tail
+    std::string input_string;
+    for (int i = 0; i < 20; ++i) {
+        input_string += "word" + std::to_string(i) + std::string(i % 4, ' ') +
+                        (i % 3 == 0 ? ",\t" : " ");
+    }
+    std::string_view input_view = input_string;
+    for (std::size_t pos = 0; pos <= input_view.size(); ++pos) {
+        EXPECT_EQ(findFirstOf(input_view, delim_set, pos),
+                  input_view.find_first_of(" \t,", pos));
+        EXPECT_EQ(findFirstNotOf(input_view, delim_set, pos),
+                  input_view.find_first_not_of(" \t,", pos));
+    }
+
+    auto words = extractWordsWith<DelimSet(" \t,")>(input_string);
+    EXPECT_EQ(words, extractWords(input_string));
+    ASSERT_EQ(words.size(), 20);
+    EXPECT_EQ(words[19], "word19");
+    EXPECT_EQ(removeFirstWord(input_string, delim_set).first,
+              input_view.substr(input_view.find("word1")));
+    EXPECT_TRUE(hasPrefixDelim(" \tword", DelimSet(" ")));
+    EXPECT_FALSE(hasPrefixDelim("word ", DelimSet(" ")));
+}
+
+TEST(OptionParser, FindBackends) {
+    using namespace OptionParser;
+    EXPECT_TRUE(isFindBackendSupported(getFindBackend()));
+
+    // more than 8 characters are scanned with the bitmap only
+    constexpr std::string_view large_delim = " \t,;:|/=+-";
+    constexpr DelimSet large_set(large_delim);
+    static_assert(large_set.char_count > large_set.chars.size());
+
+    std::string input_string;
+    for (int i = 0; i < 40; ++i) {
+        input_string += "word" + std::to_string(i) +
+                        std::string(i % 5, large_delim[i % large_delim.size()]) +
+                        (i % 3 == 0 ? ",\t" : " ") +
+                        std::string(i % 7 * 5, 'x');
+    }
+    std::string_view input_view = input_string;
+
+    for (auto backend :
+         {FindBackend::Scalar, FindBackend::Sse42, FindBackend::Avx2}) {
+        if (!isFindBackendSupported(backend))
+            continue;
+        for (std::string_view delim : {std::string_view(" \t,"), large_delim,
+                                       std::string_view("x")}) {
+            DelimSet delim_set(delim);
+            for (std::size_t pos = 0; pos <= input_view.size(); ++pos) {
+                EXPECT_EQ(findFirstOf(input_view, delim_set, pos, backend),
+                          input_view.find_first_of(delim, pos))
+                    << static_cast<int>(backend) << delim << pos;
+                EXPECT_EQ(findFirstNotOf(input_view, delim_set, pos, backend),
+                          input_view.find_first_not_of(delim, pos))
+                    << static_cast<int>(backend) << delim << pos;
+            }
+        }
+    }
+
+    for (std::size_t pos = 0; pos <= input_view.size(); ++pos) {
+        EXPECT_EQ(findFirstOf(input_view, large_set, pos),
+                  input_view.find_first_of(large_delim, pos));
+        EXPECT_EQ(findFirstNotOf(input_view, large_set, pos),
+                  input_view.find_first_not_of(large_delim, pos));
+    }
+}
+
+TEST(OptionParser, NestedList) {
+    using namespace OptionParser;
+    Parser parser(Option<ListType>("list"), Option<LazyListType>("lazy"));
+
+    std::string input_string = "list [a, [b, [c]], d] lazy [e,, [f g] h]";
+
+    auto set = parser.parse(input_string);
+    auto res = set.find<0>();
+    ASSERT_TRUE(res.has_value());
+    // ListType only splits on delimiters
+    EXPECT_EQ(res->get<0>(),
+              std::vector<std::string_view>({"a", "[b", "[c]]", "d"}));
+    EXPECT_EQ(parseList("[a, [b, c]]"),
+              std::vector<std::string_view>({"a", "[b", "c]"}));
+    auto lazy_res = set.find<1>();
+    ASSERT_TRUE(lazy_res.has_value());
+    const ListView &list_view = lazy_res->get<0>();
+    EXPECT_EQ(list_view.size(), 3);
+    EXPECT_EQ(std::vector<std::string_view>(list_view.begin(), list_view.end()),
+              std::vector<std::string_view>({"e", "[f g]", "h"}));
+    EXPECT_TRUE(ListView("[ ,, ]").empty());
+}
+
+TEST(OptionParser, ListDepthLimit) {
+    using namespace OptionParser;
+    std::string nested = std::string(300, '[') + std::string(300, ']');
+    EXPECT_EQ(searchEndOfList(nested), nested.size() - 1);
+    EXPECT_EQ(searchEndOfList(nested, '[', ']', 300), nested.size() - 1);
+    EXPECT_EQ(searchEndOfList(nested, '[', ']', 299), nested.npos);
+    EXPECT_EQ(searchEndOfList("[[a]] b", '[', ']', 2), 4);
+    EXPECT_EQ(searchEndOfList("[[a]] b", '[', ']', 1), std::string_view::npos);
+    EXPECT_EQ(extractFirstList(nested).first, nested);
+    EXPECT_TRUE(extractFirstList(nested, '[', ']', " ", 256).first.empty());
+}
+
+TEST(OptionParser, ResultSetAccess) {
+    using namespace OptionParser;
+    Parser parser(StaticOption<Identifiers<"-O">, NumberType<int>>{},
+                  StaticOption<Identifiers<"-I">, ListType>{},
+                  StaticOption<Identifiers<"-g">>{},
+                  StaticOption<Identifiers<"-o", "--output">, WordType>{});
+
+    std::string input_string = "-I [a, b] -O 2 --output main";
+
+    auto set = parser.parse(input_string);
+    auto *result_I = set.get<1>();
+    ASSERT_NE(result_I, nullptr);
+    EXPECT_EQ(result_I->get<0>(), std::vector<std::string_view>({"a", "b"}));
+    EXPECT_EQ(set.get<2>(), nullptr);
+    EXPECT_FALSE(set.contains<2>());
+    EXPECT_TRUE(set.contains<3>());
+
+    ASSERT_NE(set.get<"-O">(), nullptr);
+    EXPECT_EQ(set.get<"-O">()->get<0>(), 2);
+    EXPECT_EQ(set.get<"--output">(), set.get<"-o">());
+    EXPECT_EQ(set.get<"-o">(), set.get<3>());
+
+    const auto &[O, I, g, o] = set;
+    EXPECT_EQ(I, result_I);
+    EXPECT_EQ(g, nullptr);
+    ASSERT_NE(o, nullptr);
+    EXPECT_EQ(o->get<0>(), "main");
+    EXPECT_EQ(O->get<0>(), 2);
+
+    std::vector<std::size_t> found;
+    set.visit([&](auto i, const auto &result) {
+        found.push_back(i);
+        EXPECT_EQ(&result, set.get<i>());
+    });
+    EXPECT_EQ(found, std::vector<std::size_t>({0, 1, 3}));
+}
+
+/*
+WordType counting the live instances, throwing from parseType on the word
+"throw" and from the copy constructor once copies_until_throw reaches 0.
+*/
+struct CountedWordType {
+    CountedWordType() { ++alive; }
+    CountedWordType(const CountedWordType &other) : type(other.type) {
+        if (copies_until_throw-- == 0)
+            throw std::runtime_error("copy");
+        ++alive;
+    }
+    CountedWordType(CountedWordType &&other) noexcept : type(other.type) {
+        ++alive;
+    }
+    CountedWordType &operator=(const CountedWordType &) = default;
+    CountedWordType &operator=(CountedWordType &&) = default;
+    ~CountedWordType() { --alive; }
+
+    bool parseType(std::string_view &str_view, const std::string_view &delim) {
+        auto pair = OptionParser::extractFirstWord(str_view, delim);
+        if (pair.first == "throw")
+            throw std::runtime_error("parse");
+        if (pair.first.empty())
+            return false;
+        type = pair.first;
+        str_view.remove_prefix(pair.second);
+        return true;
+    }
+
+    std::string_view type;
+    static inline int alive = 0;
+    static inline int copies_until_throw = -1;
+};
+
+// moves by copying, so its move may throw
+struct CopyMovedWordType : CountedWordType {
+    CopyMovedWordType() = default;
+    CopyMovedWordType(const CopyMovedWordType &) = default;
+    CopyMovedWordType &operator=(const CopyMovedWordType &) = default;
+};
+
+TEST(OptionParser, ResultSetLifetime) {
+    using namespace OptionParser;
+    Parser parser(Option<CountedWordType, NumberType<int>>("-a"),
+                  Option<CountedWordType>("-b"), Option<CountedWordType>("-c"));
+
+    {
+        // the first -a is destroyed after its number fails, -c never matches
+        auto set = parser.parse("-a word x -b b -a word 1");
+        EXPECT_EQ(CountedWordType::alive, 2);
+        ASSERT_TRUE(set.contains<0>());
+        EXPECT_EQ(set.get<0>()->get<0>(), "word");
+        EXPECT_FALSE(set.contains<2>());
+
+        // copying -b throws after -a was copied
+        CountedWordType::copies_until_throw = 1;
+        EXPECT_THROW(
+            {
+                auto copy = set;
+                (void)copy;
+            },
+            std::runtime_error);
+        CountedWordType::copies_until_throw = -1;
+        EXPECT_EQ(CountedWordType::alive, 2);
+
+        decltype(set) assigned = parser.parse("-c c");
+        CountedWordType::copies_until_throw = 0;
+        EXPECT_THROW(assigned = set, std::runtime_error);
+        CountedWordType::copies_until_throw = -1;
+        EXPECT_FALSE(assigned.contains<0>());
+        EXPECT_EQ(CountedWordType::alive, 2);
+    }
+    EXPECT_EQ(CountedWordType::alive, 0);
+
+    // the result being parsed is destroyed when parseType throws
+    EXPECT_THROW(parser.parse("-b b -a throw"), std::runtime_error);
+    EXPECT_EQ(CountedWordType::alive, 0);
+
+    // moves are noexcept only if moving every result is
+    static_assert(
+        std::is_nothrow_move_constructible_v<decltype(parser.parse(""))>);
+    Parser copy_moved_parser(Option<CopyMovedWordType>("-a"),
+                             Option<CopyMovedWordType>("-b"));
+    using CopyMovedSet = decltype(copy_moved_parser.parse(""));
+    static_assert(!std::is_nothrow_move_constructible_v<CopyMovedSet>);
+    static_assert(!std::is_nothrow_move_assignable_v<CopyMovedSet>);
+    {
+        // moving -b throws after -a was moved
+        auto set = copy_moved_parser.parse("-a a -b b");
+        EXPECT_EQ(CountedWordType::alive, 2);
+        CountedWordType::copies_until_throw = 1;
+        EXPECT_THROW(
+            {
+                auto moved = std::move(set);
+                (void)moved;
+            },
+            std::runtime_error);
+        CountedWordType::copies_until_throw = -1;
+        EXPECT_EQ(CountedWordType::alive, 2);
+    }
+    EXPECT_EQ(CountedWordType::alive, 0);
+}
+
+TEST(OptionParser, ResultSetCopyAndMove) {
+    using namespace OptionParser;
+    Parser parser(Option<ListType, NumberType<int>>("-l"), Option<WordType>("-w"),
+                  Option<>("-f"));
+
+    // the first -l fails on its number and its partial result is destroyed
+    std::string input_string = "-l [a] x -w word -l [b, c] 3";
+
+    auto set = parser.parse(input_string);
+    auto copy = set;
+    auto moved = std::move(set);
+    ASSERT_TRUE(copy.contains<0>());
+    EXPECT_EQ(copy.get<0>()->get<0>(),
+              std::vector<std::string_view>({"b", "c"}));
+    EXPECT_EQ(copy.get<0>()->get<1>(), 3);
+    EXPECT_EQ(moved.get<0>()->get<0>(), copy.get<0>()->get<0>());
+    EXPECT_EQ(moved.get<1>()->get<0>(), "word");
+    EXPECT_FALSE(moved.contains<2>());
+
+    copy = parser.parse("-f");
+    EXPECT_FALSE(copy.contains<0>());
+    EXPECT_TRUE(copy.contains<2>());
+    moved = copy;
+    EXPECT_FALSE(moved.contains<1>());
+    EXPECT_TRUE(moved.contains<2>());
+}
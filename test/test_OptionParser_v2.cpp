@@ -3,6 +3,9 @@
 #include <OptionParser_v2.hpp>
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <random>
 
 TEST(tokenize, EmptyString) {
     std::string_view input_string = "";
@@ -571,3 +574,1284 @@ TEST(generateHelpString, CommandWithFlagAndParameter) {
     std::string help_string = optionparser_v2::generateHelpString(command);
     EXPECT_FALSE(help_string.empty());
 }
+
+TEST(CompiledGrammar, Layout) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeParameter("url", "url"), makeFlag("--help", "-h", "help"),
+         makeCommand("clone", "clone", {makeFlag("--depth", "", "depth")}),
+         makeRequiredFlag("--verbose", "-v", "verbose")});
+
+    CompiledGrammar grammar(root_command);
+    EXPECT_EQ(grammar.getNodes().size(), 6);
+    EXPECT_EQ(grammar.getRoots().size(), 1);
+    EXPECT_EQ(grammar.getMaxDepth(), 3);
+    EXPECT_EQ(grammar.getName(0), "git");
+    EXPECT_EQ(grammar.getNode(0).m_required_count, 1);
+
+    auto children = grammar.getChildren(0);
+    ASSERT_EQ(children.size(), 4);
+    EXPECT_EQ(children[0].m_component->getName(), "url");
+    EXPECT_EQ(children[3].m_component->getName(), "--verbose");
+
+    auto flags = grammar.getFlags(0);
+    ASSERT_EQ(flags.size(), 2);
+    EXPECT_EQ(grammar.getName(flags[0]), "--help");
+    EXPECT_EQ(grammar.getShortName(flags[0]), "-h");
+    EXPECT_EQ(grammar.getName(flags[1]), "--verbose");
+    ASSERT_EQ(grammar.getCommands(0).size(), 1);
+    EXPECT_EQ(grammar.getName(grammar.getCommands(0)[0]), "clone");
+    ASSERT_EQ(grammar.getParameters(0).size(), 1);
+    EXPECT_EQ(grammar.getName(grammar.getParameters(0)[0]), "url");
+    EXPECT_EQ(grammar.getFlags(grammar.getCommands(0)[0]).size(), 1);
+}
+
+TEST(CompiledParseContext, RecursiveHeterogeneousTree) {
+    using namespace optionparser_v2;
+    int depth = 100;
+    Component root_component = makeCommand("root", "root");
+    Component *current_component = &root_component;
+    for (int i = 0; i < depth; ++i) {
+        Component child_component = makeCommand(std::to_string(i), "child");
+        current_component->getChildrenMutable().push_back(
+            std::move(child_component));
+        current_component = &current_component->getChildrenMutable().back();
+    }
+
+    CompiledGrammar grammar(root_component);
+    CompiledParseContext context(grammar);
+    EXPECT_TRUE(context.parseToken("root"));
+    for (int i = 0; i < depth; ++i) {
+        EXPECT_TRUE(context.parseToken(std::to_string(i)));
+    }
+
+    EXPECT_FALSE(context.parseToken("notfound"));
+
+    EXPECT_TRUE(context.getRootParseResult().has_value());
+    const ParseResult &root_parse_result = context.getRootParseResult().value();
+    EXPECT_EQ(root_parse_result.m_value, "root");
+    ParseResult const *current_parse_result = &root_parse_result.m_children[0];
+    for (int i = 0; i < depth; ++i) {
+        EXPECT_EQ(current_parse_result->m_value, std::to_string(i));
+        current_parse_result = &current_parse_result->m_children[0];
+    }
+}
+
+TEST(CompiledParseContext, RequiredFlag) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeRequiredFlag("--help", "-h", "Print help message", {})});
+
+    CompiledGrammar grammar(root_command);
+    CompiledParseContext context(grammar);
+    EXPECT_FALSE(context.isComplete());
+    EXPECT_TRUE(context.parseToken("git"));
+    EXPECT_FALSE(context.isComplete());
+    EXPECT_FALSE(context.parseToken("--wrong"));
+    EXPECT_TRUE(context.parseToken("-h"));
+    EXPECT_TRUE(context.isComplete());
+}
+
+TEST(CompiledParseContext, SameResultAsParseContext) {
+    using namespace optionparser_v2;
+    std::vector<Component> root_commands = {
+        makeCommand("one", "one",
+                    {makeFlag("--flag", "-f", "flag",
+                              {makeRequiredParameter("value", "value")}),
+                     makeCommand("sub", "sub", {makeParameter("a", "a")}),
+                     makeParameter("p1", "p1"), makeParameter("p2", "p2")}),
+        makeCommand("two", "two", {makeFlag("--help", "-h", "help")}),
+    };
+    CompiledGrammar grammar(root_commands);
+
+    for (std::string_view input :
+         {"one", "two -h", "one -f x sub y z", "one a b c", "one sub -f v",
+          "one --flag", "three", "two -h -h two"}) {
+        auto expected = parseMulti(root_commands, input);
+        auto actual = parse(grammar, input);
+        ASSERT_EQ(expected.has_value(), actual.has_value()) << input;
+        if (expected.has_value()) {
+            EXPECT_EQ(serializeResult(*expected), serializeResult(*actual));
+            EXPECT_EQ(expected->m_component, actual->m_component);
+        }
+        EXPECT_EQ(nextTokenSuggestionsMulti(root_commands, input),
+                  nextTokenSuggestions(grammar, input))
+            << input;
+    }
+}
+
+TEST(CompiledParseContext, OnlySuggestNParameters) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeParameter(
+            "one", "one", {}, [](const Component &, std::string_view) {
+                return std::vector<std::string>{"one", "two", "three"};
+            })});
+
+    CompiledGrammar grammar(root_command);
+    CompiledParseContext context(grammar);
+    EXPECT_EQ(context.getNextSuggestions(), std::vector<std::string>{"git"});
+    EXPECT_TRUE(context.parseToken("git"));
+    EXPECT_EQ(context.getNextSuggestions().size(), 3);
+    EXPECT_TRUE(context.parseToken("one"));
+    EXPECT_EQ(context.getNextSuggestions().size(), 0);
+    EXPECT_FALSE(context.parseToken("two"));
+}
+
+TEST(CompiledGrammar, FindLargeFanOut) {
+    using namespace optionparser_v2;
+    std::vector<Component> children;
+    for (int i = 0; i < 500; ++i) {
+        children.push_back(makeCommand("cmd" + std::to_string(i), "command"));
+        children.push_back(makeFlag("--flag" + std::to_string(i),
+                                    "-f" + std::to_string(i), "flag"));
+    }
+    auto root_command = makeCommand("root", "root", std::move(children));
+
+    using NameMatching = CompiledGrammar::NameMatching;
+    CompiledGrammar grammar(root_command);
+    for (int i = 0; i < 500; ++i) {
+        auto command = grammar.findCommand(0, "cmd" + std::to_string(i),
+                                           NameMatching::Exact);
+        ASSERT_TRUE(command.has_value());
+        EXPECT_EQ(grammar.getName(*command), "cmd" + std::to_string(i));
+        auto flag =
+            grammar.findFlag(0, "-f" + std::to_string(i), NameMatching::Exact);
+        ASSERT_TRUE(flag.has_value());
+        EXPECT_EQ(grammar.getName(*flag), "--flag" + std::to_string(i));
+    }
+    EXPECT_FALSE(grammar.findCommand(0, "cmd", NameMatching::Exact));
+    EXPECT_FALSE(grammar.findCommand(0, "cmd500", NameMatching::Exact));
+    EXPECT_FALSE(grammar.findFlag(0, "cmd1", NameMatching::Exact));
+    EXPECT_FALSE(grammar.findCommand(0, "-f1", NameMatching::Exact));
+}
+
+TEST(CompiledGrammar, FlagsBeforeCommands) {
+    using namespace optionparser_v2;
+    auto root_command =
+        makeCommand("root", "root",
+                    {makeCommand("help", "command"),
+                     makeFlag("help", "", "flag"), makeParameter("p", "p")});
+
+    CompiledGrammar grammar(root_command);
+    auto result = parse(grammar, "root help");
+    ASSERT_TRUE(result.has_value());
+    ASSERT_EQ(result->m_children.size(), 1);
+    EXPECT_TRUE(result->m_children[0].m_component->isFlag());
+}
+
+TEST(CompiledGrammar, UniquePrefix) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeCommand("commit", "commit"), makeCommand("config", "config"),
+         makeCommand("clone", "clone"), makeCommand("co", "co"),
+         makeFlag("--verbose", "-v", "verbose"), makeParameter("p", "p")});
+
+    using NameMatching = CompiledGrammar::NameMatching;
+    CompiledGrammar grammar(root_command, NameMatching::UniquePrefix);
+
+    auto result = parse(grammar, "gi cl");
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->m_value, "gi");
+    ASSERT_EQ(result->m_children.size(), 1);
+    EXPECT_EQ(result->m_children[0].m_value, "cl");
+    EXPECT_EQ(result->m_children[0].m_component->getName(), "clone");
+
+    // exact match wins over prefix
+    result = parse(grammar, "git co");
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->m_children[0].m_component->getName(), "co");
+
+    result = parse(grammar, "git comm --verb");
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->m_children[0].m_component->getName(), "commit");
+    EXPECT_EQ(result->m_children[1].m_component->getName(), "--verbose");
+
+    // ambiguous prefix falls through to the parameter
+    result = parse(grammar, "git c");
+    ASSERT_TRUE(result.has_value());
+    EXPECT_TRUE(result->m_children[0].m_component->isParameter());
+
+    // prefixes are not accepted unless enabled
+    CompiledGrammar exact_grammar(root_command);
+    EXPECT_FALSE(parse(exact_grammar, "gi"));
+}
+
+TEST(CompiledGrammar, FindNamesWithPrefix) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeCommand("commit", "commit"), makeFlag("--color", "-c", "color"),
+         makeCommand("checkout", "checkout"), makeCommand("clone", "clone"),
+         makeCommand("custom", "custom", {},
+                     [](const Component &, std::string_view) {
+                         return std::vector<std::string>{"custom"};
+                     }),
+         makeParameter("path", "path")});
+    CompiledGrammar grammar(root_command);
+
+    auto names = [&](CompiledGrammar::NodeIndex index, std::string_view prefix) {
+        std::vector<std::string_view> result;
+        for (auto node : grammar.findNamesWithPrefix(index, prefix)) {
+            result.push_back(grammar.getName(node));
+        }
+        return result;
+    };
+    EXPECT_EQ(names(0, "c"), (std::vector<std::string_view>{
+                                 "checkout", "clone", "commit"}));
+    EXPECT_EQ(names(0, "co"), (std::vector<std::string_view>{"commit"}));
+    EXPECT_EQ(names(0, "--"), (std::vector<std::string_view>{"--color"}));
+    EXPECT_EQ(names(0, ""), (std::vector<std::string_view>{
+                                "--color", "checkout", "clone", "commit"}));
+    EXPECT_TRUE(names(0, "x").empty());
+    EXPECT_EQ(names(CompiledGrammar::npos, "g"),
+              (std::vector<std::string_view>{"git"}));
+
+    auto custom = grammar.getCustomSuggestions(0);
+    ASSERT_EQ(custom.size(), 1);
+    EXPECT_EQ(grammar.getName(custom[0]), "custom");
+    EXPECT_TRUE(grammar.getCustomSuggestions(CompiledGrammar::npos).empty());
+}
+
+TEST(CompiledParseContext, SuggestionsInDeclarationOrder) {
+    using namespace optionparser_v2;
+    std::vector<Component> children;
+    for (int i = 999; i >= 0; --i) {
+        children.push_back(makeCommand("cmd" + std::to_string(i), ""));
+        if (i % 100 == 0) {
+            children.push_back(makeParameter(
+                "p", "p", {}, [i](const Component &, std::string_view) {
+                    return std::vector<std::string>{"param" +
+                                                    std::to_string(i)};
+                }));
+        }
+    }
+    auto root_command = makeCommand("root", "root", std::move(children));
+    CompiledGrammar grammar(root_command);
+
+    for (std::string_view input :
+         {"", "r", "root ", "root cmd", "root cmd1", "root cmd99", "root x",
+          "root a b c d e f g h i j k", "root a b c d e f g h i j "}) {
+        EXPECT_EQ(nextTokenSuggestions(root_command, input),
+                  nextTokenSuggestions(grammar, input))
+            << input;
+    }
+}
+
+TEST(CompiledGrammar, FindSimilarNamesSameAsScan) {
+    using namespace optionparser_v2;
+    std::vector<Component> children;
+    std::vector<std::string> names;
+    for (int i = 0; i < 500; ++i) {
+        // names with lots of small distances between them
+        std::string name;
+        for (int n = i * 7919 % 1000 + 1; n > 0; n /= 4) {
+            name += "acgt"[n % 4];
+        }
+        names.push_back(name);
+        children.push_back(i % 2 == 0 ? makeCommand(name, "")
+                                      : makeFlag("--" + name, name, ""));
+    }
+    auto root_command = makeCommand("root", "root", std::move(children));
+    CompiledGrammar grammar(root_command);
+
+    auto distance = [](std::string_view a, std::string_view b) {
+        std::vector<std::vector<std::size_t>> d(
+            a.size() + 1, std::vector<std::size_t>(b.size() + 1));
+        for (std::size_t i = 0; i <= a.size(); ++i) {
+            for (std::size_t j = 0; j <= b.size(); ++j) {
+                if (i == 0 || j == 0) {
+                    d[i][j] = i + j;
+                } else {
+                    d[i][j] = std::min({d[i - 1][j] + 1, d[i][j - 1] + 1,
+                                        d[i - 1][j - 1] +
+                                            (a[i - 1] == b[j - 1] ? 0 : 1)});
+                }
+            }
+        }
+        return d[a.size()][b.size()];
+    };
+
+    for (std::string_view token : {"acgt", "ttt", "--acg", "gattaca", "x"}) {
+        for (std::size_t max_distance : {0, 1, 2}) {
+            std::vector<std::pair<std::size_t, std::size_t>> expected;
+            for (std::size_t i = 0; i < names.size(); ++i) {
+                std::size_t best = distance(token, names[i]);
+                if (i % 2 == 1) {
+                    best = std::min(best, distance(token, "--" + names[i]));
+                }
+                if (best <= max_distance) {
+                    expected.emplace_back(best, i);
+                }
+            }
+            std::stable_sort(expected.begin(), expected.end(),
+                             [](const auto &a, const auto &b) {
+                                 return a.first < b.first;
+                             });
+
+            auto similar_names =
+                grammar.findSimilarNames(0, token, max_distance);
+            ASSERT_EQ(similar_names.size(), expected.size()) << token;
+            for (std::size_t i = 0; i < expected.size(); ++i) {
+                EXPECT_EQ(similar_names[i].m_distance, expected[i].first);
+                EXPECT_EQ(similar_names[i].m_node,
+                          grammar.getNode(0).m_children_begin +
+                              expected[i].second);
+            }
+        }
+    }
+}
+
+TEST(nextTokenCorrections, DidYouMean) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message", {makeParameter("msg", "msg")}),
+         makeCommand("commit", "commit"), makeCommand("checkout", "checkout"),
+         makeCommand("clone", "clone")});
+    CompiledGrammar grammar(root_command);
+
+    EXPECT_EQ(nextTokenCorrections(grammar, "git comit"),
+              std::vector<std::string>{"commit"});
+    EXPECT_EQ(nextTokenCorrections(grammar, "git clone --mesage"),
+              std::vector<std::string>{"--message"});
+    EXPECT_EQ(nextTokenCorrections(grammar, "git -n"),
+              (std::vector<std::string>{"-m"}));
+    // a rejected token pops the complete git command, nothing can follow
+    EXPECT_EQ(nextTokenCorrections(grammar, "git -n "),
+              std::vector<std::string>{});
+    EXPECT_EQ(nextTokenCorrections(grammar, "git clome", 1),
+              std::vector<std::string>{"clone"});
+    EXPECT_EQ(nextTokenCorrections(grammar, "gti"),
+              std::vector<std::string>{"git"});
+
+    CompiledParseContext context(grammar);
+    EXPECT_TRUE(context.parseToken("git"));
+    EXPECT_EQ(context.getCorrections("chekout"),
+              std::vector<std::string>{"checkout"});
+    EXPECT_TRUE(context.getCorrections("push").empty());
+}
+
+TEST(parseView, PointsIntoInput) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message", {makeParameter("msg", "msg")}),
+         makeCommand("commit", "commit"), makeParameter("path", "path")});
+    CompiledGrammar grammar(root_command);
+
+    std::string input_string = "git -m \"hello world\" commit";
+    std::optional<ParseResultView> result = parseView(grammar, input_string);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(result->m_value, "git");
+    EXPECT_EQ(result->m_value.data(), input_string.data());
+    ASSERT_EQ(result->m_children.size(), 2);
+    ASSERT_EQ(result->m_children[0].m_children.size(), 1);
+    const ParseResultView &message = result->m_children[0].m_children[0];
+    EXPECT_EQ(message.m_value, "hello world");
+    EXPECT_EQ(message.m_value.data(), input_string.data() + 8);
+    EXPECT_EQ(result->m_children[1].m_component->getName(), "commit");
+
+    EXPECT_EQ(serializeResult(*result),
+              serializeResult(*parse(grammar, input_string)));
+    EXPECT_FALSE(parseView(grammar, "nope").has_value());
+}
+
+TEST(ParseContext, TakeRootParseResult) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand("git", "git", {makeParameter("p", "p")});
+
+    ParseContext context(root_command);
+    EXPECT_TRUE(context.parseToken("git"));
+    EXPECT_TRUE(context.parseToken("one"));
+    std::optional<ParseResult> result = context.takeRootParseResult();
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(serializeResult(*result), "git one");
+    EXPECT_FALSE(context.getRootParseResult().has_value());
+    EXPECT_FALSE(context.isComplete());
+}
+
+TEST(parseFlat, SameTreeAsParse) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message", {makeParameter("msg", "msg")}),
+         makeCommand("commit", "commit", {makeParameter("path", "path")}),
+         makeParameter("p1", "p1"), makeParameter("p2", "p2")});
+    CompiledGrammar grammar(root_command);
+
+    std::function<void(const ParseResult &, FlatParseResult::NodeRef)>
+        expect_equal = [&](const ParseResult &expected,
+                           FlatParseResult::NodeRef actual) {
+            EXPECT_EQ(expected.m_value, actual.getValue());
+            EXPECT_EQ(expected.m_component, actual.getComponent());
+            auto it = actual.getChildren().begin();
+            for (const auto &child : expected.m_children) {
+                ASSERT_NE(it, actual.getChildren().end());
+                expect_equal(child, *it++);
+            }
+            EXPECT_EQ(it, actual.getChildren().end());
+        };
+
+    for (std::string_view input :
+         {"git", "git -m hi commit a", "git a -m \"b c\" commit d -m e",
+          "git a b"}) {
+        auto expected = parse(grammar, input);
+        auto actual = parseFlat(grammar, input);
+        ASSERT_TRUE(expected.has_value()) << input;
+        ASSERT_TRUE(actual.has_value()) << input;
+        EXPECT_EQ(actual->getNodes().size(), tokenize(input).size());
+        expect_equal(*expected, actual->getRoot());
+        EXPECT_EQ(serializeResult(*expected), serializeResult(*actual));
+    }
+    EXPECT_FALSE(parseFlat(grammar, "svn").has_value());
+}
+
+TEST(FlatParseResult, AddNode) {
+    using namespace optionparser_v2;
+    FlatParseResult result;
+    EXPECT_TRUE(result.empty());
+    auto root = result.addNode(FlatParseResult::npos, nullptr, "root");
+    auto a = result.addNode(root, nullptr, "a");
+    result.addNode(root, nullptr, "b");
+    result.addNode(a, nullptr, "c");
+    EXPECT_EQ(serializeResult(result), "root a c b");
+    EXPECT_TRUE(result.getNode(3).getChildren().empty());
+}
+
+TEST(parseFlat, MemoryResource) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message", {makeParameter("msg", "msg")}),
+         makeCommand("commit", "commit"), makeCommand("clone", "clone")});
+    CompiledGrammar grammar(root_command);
+
+    std::array<std::byte, 4096> buffer;
+    std::pmr::monotonic_buffer_resource resource(
+        buffer.data(), buffer.size(), std::pmr::null_memory_resource());
+
+    std::string_view input_string = "git -m \"a long message text\" commit";
+    auto result = parseFlat(grammar, input_string, &resource);
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(serializeResult(*result), serializeResult(*parse(grammar,
+                                                                input_string)));
+
+    auto tokens = tokenize(input_string, &resource);
+    EXPECT_EQ(tokens.size(), 4);
+    EXPECT_EQ(tokens.get_allocator().resource(), &resource);
+
+    auto suggestions = nextTokenSuggestions(grammar, "git c", &resource);
+    EXPECT_EQ(suggestions.get_allocator().resource(), &resource);
+    EXPECT_THAT(suggestions, ::testing::ElementsAre("commit", "clone"));
+}
+
+TEST(tokenize, BackendsMatchScalar) {
+    using namespace optionparser_v2;
+    std::mt19937 generator(1234);
+    const std::string_view alphabet = "ab  \"\\";
+    std::uniform_int_distribution<std::size_t> char_distribution(
+        0, alphabet.size() - 1);
+    std::uniform_int_distribution<std::size_t> size_distribution(0, 300);
+
+    std::vector<std::string> inputs = {
+        "",
+        "one \"two \\\"three\" four",
+        std::string(64, ' ') + "x",
+        std::string(63, 'a') + "\\" + " b",
+        std::string(63, '\\') + "\" c d\"",
+        "\"" + std::string(100, ' ') + "\" e",
+    };
+    for (int i = 0; i < 2000; ++i) {
+        std::string input(size_distribution(generator), ' ');
+        for (char &c : input) {
+            c = alphabet[char_distribution(generator)];
+        }
+        inputs.push_back(std::move(input));
+    }
+
+    for (auto backend : {TokenizerBackend::Sse42, TokenizerBackend::Avx2}) {
+        if (!isTokenizerBackendSupported(backend)) {
+            continue;
+        }
+        for (const auto &input : inputs) {
+            auto expected = tokenize(input, TokenizerBackend::Scalar);
+            auto actual = tokenize(input, backend);
+            ASSERT_EQ(expected.size(), actual.size()) << input;
+            for (std::size_t i = 0; i < expected.size(); ++i) {
+                EXPECT_EQ(expected[i].data(), actual[i].data()) << input;
+                EXPECT_EQ(expected[i].size(), actual[i].size()) << input;
+            }
+        }
+    }
+    EXPECT_EQ(tokenize(inputs[1]), tokenize(inputs[1], TokenizerBackend::Scalar));
+}
+
+TEST(StreamParser, AnyChunking) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message", {makeParameter("msg", "msg")}),
+         makeCommand("commit", "commit", {makeParameter("path", "path")})});
+    CompiledGrammar grammar(root_command);
+
+    std::string_view input_string =
+        "git  -m \"a \\\"quoted\\\" message\" commit \"some path\" ";
+    const std::string expected =
+        serializeResult(*parse(root_command, input_string));
+
+    for (std::size_t chunk_size = 1; chunk_size <= input_string.size();
+         ++chunk_size) {
+        ParseContext context(root_command);
+        StreamParser stream(context);
+        CompiledParseContext compiled_context(grammar);
+        StreamParser compiled_stream(compiled_context);
+        for (std::size_t pos = 0; pos < input_string.size();
+             pos += chunk_size) {
+            // copy the chunk, so nothing can point into earlier chunks
+            std::string chunk(input_string.substr(pos, chunk_size));
+            EXPECT_TRUE(stream.feed(chunk));
+            EXPECT_TRUE(compiled_stream.feed(chunk));
+        }
+        EXPECT_TRUE(stream.finish());
+        EXPECT_TRUE(compiled_stream.finish());
+        ASSERT_TRUE(context.getRootParseResult().has_value());
+        EXPECT_EQ(serializeResult(*context.getRootParseResult()), expected);
+        EXPECT_EQ(serializeResult(*compiled_context.getRootParseResult()),
+                  expected);
+    }
+}
+
+TEST(StreamParser, RejectedToken) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand("git", "git", {makeCommand("pull", "")});
+
+    ParseContext context(root_command);
+    StreamParser stream(context);
+    EXPECT_TRUE(stream.feed("git pu"));
+    EXPECT_FALSE(stream.feed("sh "));
+    EXPECT_TRUE(stream.failed());
+    EXPECT_FALSE(stream.feed("pull"));
+    EXPECT_FALSE(stream.finish());
+}
+
+TEST(parseBatch, SameAsSequential) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message", {makeParameter("msg", "msg")}),
+         makeCommand("commit", "commit", {makeParameter("path", "path")})});
+    CompiledGrammar grammar(root_command);
+
+    std::vector<std::string> lines;
+    for (int i = 0; i < 1000; ++i) {
+        if (i % 7 == 0) {
+            lines.push_back("svn " + std::to_string(i));
+        } else {
+            lines.push_back("git -m " + std::to_string(i) + " commit p" +
+                            std::to_string(i));
+        }
+    }
+    std::vector<std::string_view> input_strings(lines.begin(), lines.end());
+
+    for (std::size_t thread_count : {0, 1, 4, 16}) {
+        auto results = parseBatch(root_command, input_strings, thread_count);
+        auto compiled_results = parseBatch(grammar, input_strings, thread_count);
+        auto multi_results =
+            parseBatchMulti({root_command}, input_strings, thread_count);
+        ASSERT_EQ(results.size(), lines.size());
+        ASSERT_EQ(compiled_results.size(), lines.size());
+        ASSERT_EQ(multi_results.size(), lines.size());
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            ASSERT_EQ(results[i].has_value(), i % 7 != 0);
+            ASSERT_EQ(compiled_results[i].has_value(), i % 7 != 0);
+            ASSERT_EQ(multi_results[i].has_value(), i % 7 != 0);
+            if (results[i].has_value()) {
+                EXPECT_EQ(serializeResult(*results[i]), lines[i]);
+                EXPECT_EQ(serializeResult(*compiled_results[i]), lines[i]);
+            }
+        }
+    }
+    EXPECT_TRUE(parseBatch(root_command, {}, 4).empty());
+}
+
+TEST(ParseContext, CheckpointRollback) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message", {makeParameter("msg", "msg")}),
+         makeCommand("commit", "commit",
+                     {makeParameter("a", "a"), makeParameter("b", "b")})});
+    CompiledGrammar grammar(root_command);
+    ParseContext context(root_command);
+    CompiledParseContext compiled_context(grammar);
+
+    auto empty = context.checkpoint();
+    auto compiled_empty = compiled_context.checkpoint();
+    for (std::string_view token : {"git", "-m", "hello"}) {
+        EXPECT_TRUE(context.parseToken(token));
+        EXPECT_TRUE(compiled_context.parseToken(token));
+    }
+    auto middle = context.checkpoint();
+    auto compiled_middle = compiled_context.checkpoint();
+    for (std::string_view token : {"commit", "x", "y"}) {
+        EXPECT_TRUE(context.parseToken(token));
+        EXPECT_TRUE(compiled_context.parseToken(token));
+    }
+    EXPECT_FALSE(context.parseToken("z"));
+    EXPECT_FALSE(compiled_context.parseToken("z"));
+
+    context.rollback(middle);
+    compiled_context.rollback(compiled_middle);
+    EXPECT_EQ(serializeResult(*context.getRootParseResult()), "git -m hello");
+    EXPECT_EQ(serializeResult(*compiled_context.getRootParseResult()),
+              "git -m hello");
+    // the parameter of -m is taken, the next token pops back to git
+    for (std::string_view token : {"commit", "z"}) {
+        EXPECT_TRUE(context.parseToken(token));
+        EXPECT_TRUE(compiled_context.parseToken(token));
+    }
+    EXPECT_EQ(serializeResult(*context.getRootParseResult()),
+              "git -m hello commit z");
+    EXPECT_EQ(serializeResult(*compiled_context.getRootParseResult()),
+              "git -m hello commit z");
+
+    context.rollback(empty);
+    compiled_context.rollback(compiled_empty);
+    EXPECT_FALSE(context.getRootParseResult().has_value());
+    EXPECT_FALSE(compiled_context.getRootParseResult().has_value());
+    EXPECT_EQ(context.getNextSuggestions(), std::vector<std::string>{"git"});
+    EXPECT_EQ(compiled_context.getNextSuggestions(),
+              std::vector<std::string>{"git"});
+}
+
+TEST(CompletionSession, SameAsNextTokenSuggestions) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message",
+                  {makeRequiredParameter("msg", "msg")}),
+         makeCommand("commit", "commit", {makeParameter("path", "path")}),
+         makeCommand("checkout", "checkout",
+                     {makeParameter("branch", "branch", {},
+                                    [](const Component &, std::string_view) {
+                                        return std::vector<std::string>{
+                                            "main", "dev"};
+                                    })})});
+    CompiledGrammar grammar(root_command);
+
+    ParseContext context(root_command);
+    CompletionSession session(context);
+    CompiledParseContext compiled_context(grammar);
+    CompletionSession compiled_session(compiled_context);
+
+    auto check = [&]() {
+        const std::string &line = session.getLine();
+        auto expected = nextTokenSuggestions(root_command, line);
+        EXPECT_EQ(session.getNextSuggestions(), expected) << line;
+        EXPECT_EQ(compiled_session.getNextSuggestions(), expected) << line;
+    };
+
+    // type character by character, then backspace over everything
+    std::string_view line =
+        "git -m \"a \\\"quoted\\\" message\" checkout de  push  co";
+    for (char c : line) {
+        session.append(std::string_view(&c, 1));
+        compiled_session.append(std::string_view(&c, 1));
+        check();
+    }
+    while (!session.getLine().empty()) {
+        session.erase();
+        compiled_session.erase();
+        check();
+    }
+
+    for (std::string_view edit :
+         {"git commit x", "git commit", "git -m msg commit", "git -m", "svn",
+          "git checkout ", "git -m \"x y\" checkout ma", "git -m \"x y\""}) {
+        session.setLine(edit);
+        compiled_session.setLine(edit);
+        check();
+    }
+}
+
+TEST(nextTokenSuggestions, SinkMaxCount) {
+    using namespace optionparser_v2;
+    // enumerates lots of hosts, but only as many as the sink takes
+    std::size_t generated = 0;
+    auto host = makeParameter("host", "host");
+    host.setSuggestionsSinkFunc([&](const Component &, std::string_view token,
+                                    const SuggestionSink &sink) {
+        for (int i = 0; i < 100000; ++i) {
+            std::string name = "host" + std::to_string(i);
+            if (!name.starts_with(token)) {
+                continue;
+            }
+            ++generated;
+            if (!sink(name)) {
+                return false;
+            }
+        }
+        return true;
+    });
+    auto root_command =
+        makeCommand("ssh", "ssh", {makeFlag("--verbose", "-v", "verbose"),
+                                   std::move(host)});
+    CompiledGrammar grammar(root_command);
+
+    std::vector<std::string> suggestions;
+    auto sink = [&](std::string_view suggestion) {
+        suggestions.emplace_back(suggestion);
+        return true;
+    };
+    EXPECT_EQ(nextTokenSuggestions(root_command, "ssh ", sink, 20), 20);
+    EXPECT_EQ(generated, 19);
+    EXPECT_EQ(suggestions.front(), "--verbose");
+    EXPECT_EQ(suggestions.back(), "host18");
+
+    suggestions.clear();
+    generated = 0;
+    EXPECT_EQ(nextTokenSuggestions(grammar, "ssh host12", sink, 3), 3);
+    EXPECT_EQ(suggestions,
+              (std::vector<std::string>{"host12", "host120", "host121"}));
+    EXPECT_EQ(generated, 3);
+
+    // the sink can stop on its own, and the vector overloads see everything
+    suggestions.clear();
+    EXPECT_EQ(nextTokenSuggestionsMulti({root_command}, "ssh host9999",
+                                        [&](std::string_view suggestion) {
+                                            suggestions.emplace_back(
+                                                suggestion);
+                                            return false;
+                                        }),
+              1);
+    EXPECT_EQ(suggestions, std::vector<std::string>{"host9999"});
+    EXPECT_EQ(nextTokenSuggestions(root_command, "ssh host9999").size(), 11);
+    EXPECT_EQ(nextTokenSuggestions(grammar, "ssh host9999").size(), 11);
+    EXPECT_EQ(nextTokenSuggestions(root_command, "ssh ", sink, 0), 0);
+}
+
+constexpr optionparser_v2::StaticComponent makeStaticGitCommand() {
+    using namespace optionparser_v2;
+    return makeStaticCommand(
+        "git",
+        {makeStaticFlag("--message", "-m", {makeRequiredStaticParameter("msg")}),
+         makeStaticCommand("commit", {makeStaticParameter("path")}),
+         makeStaticCommand("checkout"), makeStaticCommand("clone"),
+         makeRequiredStaticFlag("--verbose", "-v"), makeStaticParameter("p1"),
+         makeStaticParameter("p2")});
+}
+
+constexpr auto static_git_grammar =
+    optionparser_v2::makeStaticGrammar<makeStaticGitCommand>();
+
+TEST(StaticGrammar, SameAsCompiledGrammar) {
+    using namespace optionparser_v2;
+    static_assert(static_git_grammar.getTables().m_nodes.size() == 10);
+    static_assert(static_git_grammar.getTables().m_nodes[0].m_required_count ==
+                  1);
+    static_assert(static_git_grammar.getTables().m_max_depth == 3);
+
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message",
+                  {makeRequiredParameter("msg", "msg")}),
+         makeCommand("commit", "commit", {makeParameter("path", "path")}),
+         makeCommand("checkout", "checkout"), makeCommand("clone", "clone"),
+         makeRequiredFlag("--verbose", "-v", "verbose"),
+         makeParameter("p1", "p1"), makeParameter("p2", "p2")});
+    CompiledGrammar expected_grammar(root_command);
+    CompiledGrammar grammar(static_git_grammar);
+    EXPECT_EQ(grammar.getNodes().size(), expected_grammar.getNodes().size());
+    EXPECT_EQ(grammar.getNode(0).m_component, nullptr);
+
+    for (std::string_view input :
+         {"", "g", "git", "git c", "git -v ", "git -m", "git -m hi ",
+          "git -v commit a ", "git a b c", "git --verbose clone ", "git comit",
+          "git -v -m", "svn"}) {
+        auto expected = parse(expected_grammar, input);
+        auto actual = parse(grammar, input);
+        ASSERT_EQ(expected.has_value(), actual.has_value()) << input;
+        if (expected.has_value()) {
+            EXPECT_EQ(serializeResult(*expected), serializeResult(*actual));
+        }
+        EXPECT_EQ(nextTokenSuggestions(expected_grammar, input),
+                  nextTokenSuggestions(grammar, input))
+            << input;
+        EXPECT_EQ(nextTokenCorrections(expected_grammar, input),
+                  nextTokenCorrections(grammar, input))
+            << input;
+
+        CompiledParseContext expected_context(expected_grammar);
+        CompiledParseContext context(grammar);
+        for (std::string_view token : tokenize(input)) {
+            EXPECT_EQ(expected_context.parseToken(token),
+                      context.parseToken(token));
+        }
+        EXPECT_EQ(expected_context.isComplete(), context.isComplete())
+            << input;
+    }
+
+    // flat results identify the matched nodes without a Component
+    auto result = parseFlat(grammar, "git -v commit a");
+    ASSERT_TRUE(result.has_value());
+    std::vector<std::string_view> names;
+    for (const auto &node : result->getNodes()) {
+        names.push_back(grammar.getName(node.m_grammar_node));
+    }
+    EXPECT_EQ(names, (std::vector<std::string_view>{"git", "--verbose",
+                                                     "commit", "path"}));
+}
+
+TEST(serializeGrammar, LoadAndMap) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--message", "-m", "message",
+                  {makeRequiredParameter("msg", "msg")}),
+         makeCommand("commit", "commit", {makeParameter("path", "path")}),
+         makeCommand("checkout", "checkout"), makeCommand("clone", "clone"),
+         makeRequiredFlag("--verbose", "-v", "verbose"),
+         makeParameter("p1", "p1")});
+    CompiledGrammar expected_grammar(root_command);
+    std::string data = serializeGrammar(root_command);
+
+    std::string path =
+        (std::filesystem::temp_directory_path() /
+         ("test_OptionParser_v2_" + std::to_string(std::random_device()()) +
+          ".grammar"))
+            .string();
+    std::ofstream(path, std::ios::binary) << data;
+    std::optional<CompiledGrammar> mapped_grammar = mapGrammarFile(path);
+    std::filesystem::remove(path);
+    ASSERT_TRUE(mapped_grammar.has_value());
+    std::optional<CompiledGrammar> loaded_grammar = loadGrammar(data);
+    ASSERT_TRUE(loaded_grammar.has_value());
+
+    // a copy keeps the mapping alive
+    CompiledGrammar grammar = *mapped_grammar;
+    mapped_grammar.reset();
+
+    for (const CompiledGrammar *actual_grammar : {&*loaded_grammar, &grammar}) {
+        EXPECT_EQ(actual_grammar->getNodes().size(),
+                  expected_grammar.getNodes().size());
+        for (std::string_view input :
+             {"", "git", "git c", "git -v -m hi commit a ", "git a b",
+              "git comit", "svn"}) {
+            auto expected = parse(expected_grammar, input);
+            auto actual = parse(*actual_grammar, input);
+            ASSERT_EQ(expected.has_value(), actual.has_value()) << input;
+            if (expected.has_value()) {
+                EXPECT_EQ(serializeResult(*expected), serializeResult(*actual));
+            }
+            EXPECT_EQ(nextTokenSuggestions(expected_grammar, input),
+                      nextTokenSuggestions(*actual_grammar, input))
+                << input;
+            EXPECT_EQ(nextTokenCorrections(expected_grammar, input),
+                      nextTokenCorrections(*actual_grammar, input))
+                << input;
+        }
+    }
+
+    EXPECT_FALSE(loadGrammar(std::string_view(data).substr(0, 16)));
+    std::string corrupt = data;
+    corrupt[0] = 'X';
+    EXPECT_FALSE(loadGrammar(corrupt));
+    corrupt = data.substr(0, data.size() - 1);
+    EXPECT_FALSE(loadGrammar(corrupt));
+    EXPECT_FALSE(mapGrammarFile(path));
+
+    // version 1 files have no m_typed in their nodes
+    GrammarFileHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    EXPECT_EQ(header.m_version, 2u);
+    header.m_version = 1;
+    corrupt = data;
+    std::memcpy(corrupt.data(), &header, sizeof(header));
+    EXPECT_FALSE(loadGrammar(corrupt));
+
+    // a typed flag in a file does not reach the missing component
+    corrupt = data;
+    for (std::size_t i = 0; i < header.m_nodes.m_size; ++i) {
+        corrupt[header.m_nodes.m_offset + i * sizeof(CompiledGrammar::Node) +
+                offsetof(CompiledGrammar::Node, m_typed)] = 1;
+    }
+    loaded_grammar = loadGrammar(corrupt);
+    ASSERT_TRUE(loaded_grammar.has_value());
+    auto result = parse(*loaded_grammar, "git -m hi commit a");
+    ASSERT_TRUE(result.has_value());
+    EXPECT_EQ(serializeResult(*result), "git -m hi commit a");
+}
+
+TEST(serializeGrammar, RequiredPastMask) {
+    using namespace optionparser_v2;
+    // more required flags than the mask of a frame holds
+    constexpr std::size_t flag_count = CompiledGrammar::required_mask_size + 6;
+    std::vector<Component> flags;
+    for (std::size_t i = 0; i < flag_count; ++i) {
+        flags.push_back(makeRequiredFlag("--f" + std::to_string(i), "", ""));
+    }
+    Component root_command = makeCommand("cmd", "cmd", std::move(flags));
+    std::string data = serializeGrammar(root_command);
+
+    std::string path =
+        (std::filesystem::temp_directory_path() /
+         ("test_OptionParser_v2_" + std::to_string(std::random_device()()) +
+          ".grammar"))
+            .string();
+    std::ofstream(path, std::ios::binary) << data;
+    std::optional<CompiledGrammar> mapped_grammar = mapGrammarFile(path);
+    std::filesystem::remove(path);
+    ASSERT_TRUE(mapped_grammar.has_value());
+    CompiledGrammar grammar(root_command);
+
+    for (std::size_t missing :
+         {std::size_t(0), flag_count - 4,
+          flag_count}) {
+        std::string input = "cmd";
+        for (std::size_t i = 0; i < flag_count; ++i) {
+            if (i != missing) {
+                input += " --f" + std::to_string(i);
+            }
+        }
+        // a repeated flag does not stand in for the missing one
+        input += " --f1";
+        const bool complete = missing == flag_count;
+        for (const CompiledGrammar *actual_grammar :
+             {&*mapped_grammar, &grammar}) {
+            CompiledParseContext context(*actual_grammar);
+            for (auto token : tokenize(input)) {
+                ASSERT_TRUE(context.parseToken(token)) << token;
+            }
+            EXPECT_EQ(context.isComplete(), complete) << missing;
+        }
+        ParseContext context(root_command);
+        for (auto token : tokenize(input)) {
+            ASSERT_TRUE(context.parseToken(token)) << token;
+        }
+        EXPECT_EQ(context.isComplete(), complete) << missing;
+    }
+}
+
+TEST(ParameterType, Convert) {
+    using namespace optionparser_v2;
+    ParameterType port = makeIntegerType(1, 65535);
+    EXPECT_EQ(port.convert("8080"), TypedValue(std::int64_t(8080)));
+    EXPECT_FALSE(port.convert("0").has_value());
+    EXPECT_FALSE(port.convert("65536").has_value());
+    EXPECT_FALSE(port.convert("80a").has_value());
+    EXPECT_FALSE(port.convert("").has_value());
+    EXPECT_EQ(makeIntegerType().convert("-12"), TypedValue(std::int64_t(-12)));
+
+    ParameterType ratio = makeFloatType(0.0, 1.0);
+    EXPECT_EQ(ratio.convert("0.25"), TypedValue(0.25));
+    EXPECT_FALSE(ratio.convert("1.5").has_value());
+    EXPECT_FALSE(ratio.convert("nan").has_value());
+
+    ParameterType boolean = makeBooleanType();
+    EXPECT_EQ(boolean.convert("yes"), TypedValue(true));
+    EXPECT_EQ(boolean.convert("0"), TypedValue(false));
+    EXPECT_FALSE(boolean.convert("maybe").has_value());
+    EXPECT_EQ(boolean.getSuggestions("t"), std::vector<std::string>{"true"});
+
+    ParameterType color = makeChoiceType({"red", "green", "blue"});
+    ParameterType copy = color;
+    EXPECT_EQ(copy.convert("blue"), TypedValue(std::size_t(2)));
+    EXPECT_FALSE(copy.convert("Blue").has_value());
+    EXPECT_EQ(copy.getChoices().size(), 3);
+
+    EXPECT_EQ(ParameterType().convert("anything"), TypedValue());
+}
+
+TEST(makeTypedParameter, ParseAndSuggest) {
+    using namespace optionparser_v2;
+    auto root_command = makeCommand(
+        "serve", "serve",
+        {makeFlag("--port", "-p", "port",
+                  {makeRequiredTypedParameter("port", "port",
+                                              makeIntegerType(1, 65535))}),
+         makeFlag("--level", "-l", "level",
+                  {makeTypedParameter("level", "level",
+                                      makeChoiceType({"debug", "info"}))}),
+         makeTypedParameter("ratio", "ratio", makeFloatType(0, 1)),
+         makeParameter("path", "path")});
+    CompiledGrammar grammar(root_command);
+
+    for (std::string_view input :
+         {"serve -p 8080 0.5 a", "serve -p 0", "serve -p x", "serve -l info",
+          "serve -l 0.5 a", "serve -l warn", "serve a b", "serve 2 a"}) {
+        auto expected = parse(root_command, input);
+        auto actual = parse(grammar, input);
+        ASSERT_EQ(expected.has_value(), actual.has_value()) << input;
+        if (expected.has_value()) {
+            EXPECT_EQ(serializeResult(*expected), serializeResult(*actual));
+        }
+        EXPECT_EQ(nextTokenSuggestions(root_command, input),
+                  nextTokenSuggestions(grammar, input))
+            << input;
+    }
+
+    auto result = parse(grammar, "serve -p 8080 0.5 a");
+    ASSERT_EQ(result->m_children.size(), 3);
+    EXPECT_EQ(result->m_children[0].m_children[0].m_typed_value,
+              TypedValue(std::int64_t(8080)));
+    EXPECT_EQ(result->m_children[1].m_typed_value, TypedValue(0.5));
+    EXPECT_EQ(result->m_children[2].m_typed_value, TypedValue());
+    // the required port rejects x, and the flag cannot be left incomplete
+    EXPECT_FALSE(parse(root_command, "serve -p x").has_value());
+    EXPECT_FALSE(parse(grammar, "serve -p 65536").has_value());
+    // an optional level that rejects a token gives it back to serve
+    auto level_result = parse(root_command, "serve -l 0.5 a");
+    ASSERT_EQ(level_result->m_children.size(), 3);
+    EXPECT_EQ(level_result->m_children[1].m_typed_value, TypedValue(0.5));
+
+    auto flat_result = parseFlat(grammar, "serve -l info");
+    ASSERT_TRUE(flat_result.has_value());
+    EXPECT_EQ(flat_result->getNodes().back().m_typed_value,
+              TypedValue(std::size_t(1)));
+    EXPECT_EQ(nextTokenSuggestions(grammar, "serve -l d"),
+              std::vector<std::string>{"debug"});
+}
+
+TEST(ParseResultIndex, FindAndPath) {
+    using namespace optionparser_v2;
+    Component root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--verbose", "-v", "verbose"),
+         makeCommand("remote", "remote",
+                     {makeFlag("--verbose", "-v", "verbose"),
+                      makeParameter("name", "name")}),
+         makeCommand("push", "push", {makeParameter("branch", "branch")})});
+
+    auto result = parse(root_command, "git -v remote -v origin");
+    ASSERT_TRUE(result.has_value());
+    ParseResultIndex index(*result);
+
+    const Component &verbose = root_command.getChildren()[0];
+    const Component &remote = root_command.getChildren()[1];
+    const Component &push = root_command.getChildren()[2];
+    EXPECT_EQ(index.find(*result, verbose), &result->m_children[0]);
+    EXPECT_EQ(index.find(*result, remote), &result->m_children[1]);
+    EXPECT_EQ(index.find(*result, push), nullptr);
+
+    auto remote_verbose = makeResultPath(root_command, "git/remote/--verbose");
+    auto remote_name = makeResultPath(root_command, "git/remote/name");
+    auto push_branch = makeResultPath(root_command, "git/push/branch");
+    ASSERT_TRUE(remote_verbose.has_value());
+    ASSERT_TRUE(remote_name.has_value());
+    ASSERT_TRUE(push_branch.has_value());
+    EXPECT_EQ(makeResultPath(root_command, "git/remote/-v")
+                  ->getComponents()
+                  .back(),
+              remote_verbose->getComponents().back());
+    EXPECT_FALSE(makeResultPath(root_command, "git/pull").has_value());
+    EXPECT_FALSE(makeResultPath(root_command, "svn/remote").has_value());
+
+    EXPECT_EQ(index.find(*remote_verbose),
+              &result->m_children[1].m_children[0]);
+    ASSERT_NE(index.find(*remote_name), nullptr);
+    EXPECT_EQ(index.find(*remote_name)->m_value, "origin");
+    EXPECT_FALSE(index.contains(*push_branch));
+
+    // repeated components resolve to the first match
+    auto repeated = parse(root_command, "git -v -v push main");
+    ASSERT_TRUE(repeated.has_value());
+    ParseResultIndex repeated_index(*repeated);
+    EXPECT_EQ(repeated_index.find(*repeated, verbose),
+              &repeated->m_children[0]);
+
+    CompiledGrammar grammar(root_command);
+    std::string input = "git push main";
+    auto view_result = parseView(grammar, input);
+    ASSERT_TRUE(view_result.has_value());
+    ParseResultViewIndex view_index(*view_result);
+    ASSERT_NE(view_index.find(*push_branch), nullptr);
+    EXPECT_EQ(view_index.find(*push_branch)->m_value, "main");
+    EXPECT_FALSE(view_index.contains(*remote_verbose));
+}
+
+TEST(serializeResult, QuotesRoundTrip) {
+    using namespace optionparser_v2;
+    Component root_command = makeCommand(
+        "git", "git",
+        {makeFlag("-m", "", "message", {makeParameter("message", "message")}),
+         makeParameter("path", "path")});
+    CompiledGrammar grammar(root_command);
+
+    for (std::string_view input :
+         {"git -m \"hello world\" a", "git -m \"a \\\"b\\\" c\" \"\"",
+          "git -m \"\\\"x\\\"\" \"a b\"", "git -m a\"b c\"d e"}) {
+        auto result = parse(root_command, input);
+        ASSERT_TRUE(result.has_value()) << input;
+        EXPECT_TRUE(canSerializeResult(*result)) << input;
+        std::string serialized = serializeResult(*result);
+        EXPECT_EQ(serialized.size(), getSerializedResultSize(*result));
+
+        std::vector<std::string_view> expected_tokens = tokenize(input);
+        std::vector<std::string_view> tokens = tokenize(serialized);
+        EXPECT_EQ(tokens, expected_tokens) << serialized;
+
+        auto flat_result = parseFlat(grammar, input);
+        ASSERT_TRUE(flat_result.has_value());
+        EXPECT_EQ(serializeResult(*flat_result), serialized);
+        EXPECT_EQ(getSerializedResultSize(*flat_result), serialized.size());
+
+        std::string output = "log: ";
+        serializeResult(*result, output);
+        EXPECT_EQ(output, "log: " + serialized);
+    }
+    EXPECT_EQ(serializeResult(*parse(root_command, "git -m \"a b\" c")),
+              "git -m \"a b\" c");
+
+    // tokens given to parseToken directly, like argv, can have unbalanced
+    // quotes that tokenize cannot read back
+    ParseContext context(root_command);
+    for (std::string_view token : {"git", "-m", "a\"b", "tail"}) {
+        ASSERT_TRUE(context.parseToken(token)) << token;
+    }
+    const auto &result = context.getRootParseResult();
+    ASSERT_TRUE(result.has_value());
+    EXPECT_FALSE(canSerializeResult(*result));
+    std::string serialized = serializeResult(*result);
+    EXPECT_EQ(serialized, "git -m a\"b tail");
+    EXPECT_EQ(tokenize(serialized),
+              (std::vector<std::string_view>{"git", "-m", "a\"b tail"}));
+
+    // a backslash at the end would escape the closing quote
+    ParseContext backslash_context(root_command);
+    for (std::string_view token : {"git", "-m", "a b\\", "c"}) {
+        ASSERT_TRUE(backslash_context.parseToken(token)) << token;
+    }
+    EXPECT_FALSE(
+        canSerializeResult(*backslash_context.getRootParseResult()));
+}
+
+TEST(serializeResult, DeepResult) {
+    using namespace optionparser_v2;
+    constexpr std::size_t depth = 1000;
+    ParseResult root_result{"0", nullptr, {}, {}};
+    ParseResult *current = &root_result;
+    std::string expected = "0";
+    for (std::size_t i = 1; i < depth; ++i) {
+        current->m_children.push_back({std::to_string(i), nullptr, {}, {}});
+        current = &current->m_children.back();
+        expected += ' ';
+        expected += std::to_string(i);
+    }
+    EXPECT_EQ(serializeResult(root_result), expected);
+    EXPECT_EQ(getSerializedResultSize(root_result), expected.size());
+    EXPECT_EQ(getLastParseResult(root_result).m_value,
+              std::to_string(depth - 1));
+}
+
+TEST(HelpRenderer, SubcommandAndCache) {
+    using namespace optionparser_v2;
+    Component root_command = makeCommand(
+        "git", "git",
+        {makeFlag("--help", "-h", "Print help message"),
+         makeCommand("clone", "Clone a repository",
+                     {makeFlag("--depth", "", "Shallow clone",
+                               {makeParameter("depth", "depth")}),
+                      makeRequiredParameter("repository", "url")}),
+         makeParameter("pathspec", "pathspec")});
+    const Component &clone = root_command.getChildren()[1];
+
+    HelpRenderer renderer(root_command, 20);
+    EXPECT_EQ(renderer.getHelpString(root_command),
+              generateHelpString(root_command, 20));
+    EXPECT_EQ(renderer.getUsageString(root_command),
+              generateUsageString(root_command));
+    EXPECT_EQ(renderer.getHelpString(root_command),
+              "git <pathspec>      git\n"
+              "    --help          Print help message\n"
+              "    clone <repository>\n"
+              "                    Clone a repository\n"
+              "        --depth <depth>\n"
+              "                    Shallow clone\n");
+    EXPECT_EQ(renderer.getUsageString(root_command),
+              "Usage: git [--help] <command> [<pathspec>]");
+
+    // a subcommand is rendered on its own at no indent
+    EXPECT_EQ(renderer.getHelpString(clone),
+              "clone <repository>  Clone a repository\n"
+              "    --depth <depth>\n"
+              "                    Shallow clone\n");
+    EXPECT_EQ(renderer.getUsageString(clone),
+              "Usage: clone [--depth [<depth>]] <repository>");
+    std::string streamed;
+    EXPECT_TRUE(renderer.renderHelp(
+        clone, [&](std::string_view text) { streamed += text; }));
+    EXPECT_EQ(streamed, renderer.getHelpString(clone));
+
+    Component other = makeCommand("svn", "svn");
+    EXPECT_FALSE(renderer.renderUsage(other, [](std::string_view) {}));
+    EXPECT_TRUE(renderer.getHelpString(other).empty());
+
+    // cached text is kept until rebuild, which picks up the mutation
+    const std::string clone_help(renderer.getHelpString(clone));
+    root_command.getChildrenMutable()[1].getChildrenMutable().push_back(
+        makeFlag("--bare", "", "Bare repository"));
+    EXPECT_EQ(renderer.getHelpString(clone), clone_help);
+    EXPECT_EQ(renderer.getUsageString(clone),
+              "Usage: clone [--depth [<depth>]] <repository>");
+    renderer.rebuild();
+    EXPECT_EQ(renderer.getUsageString(clone),
+              "Usage: clone [--depth [<depth>]] [--bare] <repository>");
+    EXPECT_EQ(renderer.getUsageString(clone), generateUsageString(clone));
+    EXPECT_EQ(renderer.getHelpString(clone), generateHelpString(clone, 20));
+
+    // children added through a held reference are seen after rebuild
+    auto &children = root_command.getChildrenMutable();
+    children.push_back(makeFlag("--version", "", "Print version"));
+    renderer.rebuild();
+    EXPECT_EQ(renderer.getUsageString(root_command),
+              "Usage: git [--help] [--version] <command> [<pathspec>]");
+    EXPECT_EQ(renderer.getHelpString(root_command),
+              generateHelpString(root_command, 20));
+
+    // usage is rendered from the table, with the separators of
+    // generateUsageString for several commands
+    Component tool = makeCommand(
+        "tool", "tool",
+        {makeCommand("a", "a"), makeCommand("b", "b"),
+         makeRequiredParameter("file", "file")});
+    HelpRenderer tool_renderer(tool);
+    EXPECT_EQ(tool_renderer.getUsageString(tool), generateUsageString(tool));
+}
+
+TEST(ParseContext, RequiredChildrenPastMask) {
+    using namespace optionparser_v2;
+    std::vector<Component> children;
+    for (int i = 0; i < 70; ++i) {
+        children.push_back(makeFlag("--flag" + std::to_string(i), "", "flag"));
+    }
+    children[3] = makeRequiredFlag("--flag3", "", "flag");
+    children[66] = makeRequiredFlag("--flag66", "", "flag");
+    children.push_back(makeRequiredParameter("path", "path"));
+    Component root_command = makeCommand("root", "root", std::move(children));
+
+    ParseContext context(root_command);
+    ASSERT_TRUE(context.parseToken("root"));
+    ASSERT_TRUE(context.parseToken("--flag3"));
+    ASSERT_TRUE(context.parseToken("--flag3"));
+    EXPECT_FALSE(context.isComplete());
+    auto checkpoint = context.checkpoint();
+    ASSERT_TRUE(context.parseToken("--flag66"));
+    EXPECT_FALSE(context.isComplete());
+    ASSERT_TRUE(context.parseToken("a"));
+    EXPECT_TRUE(context.isComplete());
+    // the only parameter is taken, only flags are suggested
+    EXPECT_EQ(context.getNextSuggestions("").size(), 70);
+
+    context.rollback(checkpoint);
+    ASSERT_TRUE(context.parseToken("a"));
+    EXPECT_FALSE(context.isComplete());
+    ASSERT_TRUE(context.parseToken("--flag66"));
+    EXPECT_TRUE(context.isComplete());
+    EXPECT_EQ(serializeResult(*context.getRootParseResult()),
+              "root --flag3 --flag3 a --flag66");
+}